@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Check if directory and shard count are provided
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 <directory> <num_shards>"
+    exit 1
+fi
+
+directory=$1
+shards=$2
+
+# Check if directory exists
+if [ ! -d "$directory" ]; then
+    echo "Error: Directory $directory does not exist."
+    exit 1
+fi
+
+# One array task per shard; each runs its part of the genomes with all five
+# algorithms and writes shard_<i>_of_<N>.csv to the current directory.
+# The merge job starts once every task has succeeded.
+array_job=$(sbatch --parsable --array=0-$((shards - 1)) --cpus-per-task=4 \
+    --wrap "./prophage_signal_processor batch \"$directory\" . mwa:70:0.2 rle:8 dbscan:50:20 median:50 ccl:40:8 --jobs 4 --shard \$SLURM_ARRAY_TASK_ID/$shards")
+sbatch --dependency=afterok:"$array_job" --wrap "./prophage_signal_processor merge ."
+
+echo "Submitted $shards shards as job $array_job. Full results will be in results_table.csv, algorithm averages in final_averages.csv"
@@ -0,0 +1,493 @@
+// batch.cpp
+
+#include "prophage_signal_processor.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <sstream>
+#include "result_cache.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+// Configurations used by slurm_scripts/run_psp_all.sh
+static const char* DEFAULT_BATCH_ALGORITHMS[] = {"mwa:70:0.2", "rle:8", "dbscan:50:20", "median:50", "ccl:40:8"};
+
+static bool isInputFile(const fs::path& path) {
+    return path.extension() == ".csv" || path.extension() == ".pstrack";
+}
+
+std::vector<std::string> collectInputFiles(const std::string& source) {
+    std::vector<std::string> files;
+    if (fs::is_directory(source)) {
+        for (const auto& entry : fs::directory_iterator(source)) {
+            if (isInputFile(entry.path())) files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+    if (isInputFile(source)) {
+        return {source};
+    }
+
+    std::ifstream manifest(source);
+    if (!manifest.is_open()) {
+        throw std::runtime_error("Could not open manifest: " + source);
+    }
+    fs::path base = fs::path(source).parent_path();
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        fs::path file(line);
+        files.push_back((file.is_absolute() ? file : base / file).string());
+    }
+    return files;
+}
+
+std::vector<size_t> shardFiles(const std::vector<std::string>& files, int shard, int shards) {
+    // Largest file first onto the least loaded shard, ties going to the lower
+    // index, so every shard computes the same partition on its own
+    std::vector<uintmax_t> sizes(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::error_code error;
+        uintmax_t size = fs::file_size(files[i], error);
+        sizes[i] = error ? 0 : size;
+    }
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    std::vector<uintmax_t> load(shards, 0);
+    std::vector<size_t> assigned;
+    for (size_t i : order) {
+        int target = static_cast<int>(std::min_element(load.begin(), load.end()) - load.begin());
+        load[target] += sizes[i];
+        if (target == shard) assigned.push_back(i);
+    }
+    std::sort(assigned.begin(), assigned.end());
+    return assigned;
+}
+
+// One genome's confusion counts under one configuration
+struct BatchRow {
+    size_t index = 0;  // position in the input list, so merged tables keep batch order
+    std::string filename;
+    size_t config = 0;
+    Metrics metrics;
+};
+
+static std::string partialFileName(int shard, int shards) {
+    return "shard_" + std::to_string(shard) + "_of_" + std::to_string(shards) + ".csv";
+}
+
+// Writes results_table.csv and final_averages.csv as batch always has, plus
+// final_pooled.csv with every file's counts summed. Rows must be ordered by
+// index, then config.
+static void writeBatchTables(const fs::path& outputDir, const std::vector<std::string>& specs,
+                             const std::vector<BatchRow>& rows) {
+    std::ofstream table(outputDir / "results_table.csv");
+    table << "Filename,Algorithm,Accuracy,Precision,Recall,F1_Score,MCC\n";
+    std::vector<Metrics> sums(specs.size());
+    std::vector<Metrics> pooled(specs.size());
+    size_t processed = 0;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        if (r == 0 || rows[r].index != rows[r - 1].index) ++processed;
+        const Metrics& m = rows[r].metrics;
+        size_t c = rows[r].config;
+        table << rows[r].filename << "," << specs[c] << ","
+              << m.accuracy << "," << m.precision << "," << m.recall << "," << m.f1 << "," << m.mcc << "\n";
+
+        // Undefined scores are already 0, as the shell pipeline patched them
+        sums[c].accuracy += m.accuracy;
+        sums[c].precision += m.precision;
+        sums[c].recall += m.recall;
+        sums[c].f1 += m.f1;
+        sums[c].mcc += m.mcc;
+        pooled[c].tp += m.tp;
+        pooled[c].fp += m.fp;
+        pooled[c].tn += m.tn;
+        pooled[c].fn += m.fn;
+    }
+
+    std::ofstream averages(outputDir / "final_averages.csv");
+    averages << "Algorithm,Accuracy,Precision,Recall,F1,MCC\n";
+    double count = static_cast<double>(std::max<size_t>(processed, 1));
+    for (size_t c = 0; c < specs.size(); ++c) {
+        averages << specs[c] << ","
+                 << sums[c].accuracy / count << "," << sums[c].precision / count << ","
+                 << sums[c].recall / count << "," << sums[c].f1 / count << "," << sums[c].mcc / count << "\n";
+    }
+
+    // Scores of the summed counts, i.e. every window of every genome weighted equally
+    std::ofstream totals(outputDir / "final_pooled.csv");
+    totals << "Algorithm,TP,FP,TN,FN,Accuracy,Precision,Recall,F1,MCC\n";
+    for (size_t c = 0; c < specs.size(); ++c) {
+        Metrics m = metricsFromCounts(pooled[c].tp, pooled[c].fp, pooled[c].tn, pooled[c].fn);
+        totals << specs[c] << "," << m.tp << "," << m.fp << "," << m.tn << "," << m.fn << ","
+               << m.accuracy << "," << m.precision << "," << m.recall << "," << m.f1 << "," << m.mcc << "\n";
+    }
+    if (!table || !averages || !totals) {
+        throw std::runtime_error("Could not write batch tables to " + outputDir.string());
+    }
+}
+
+// A shard's partial result: a few "# key value" lines naming the shard, the
+// size of the whole input list and the configurations, then one row of raw
+// counts per processed file and configuration. Counts are integers, so the
+// merge reproduces an unsharded run exactly.
+static void writePartial(const fs::path& filename, int shard, int shards, size_t totalFiles, size_t assignedFiles,
+                         const std::vector<std::string>& specs, const std::vector<BatchRow>& rows) {
+    std::ofstream out(filename);
+    out << "# shard " << shard << "/" << shards << "\n";
+    out << "# files " << totalFiles << " " << assignedFiles << "\n";
+    out << "# algorithms";
+    for (const auto& spec : specs) out << " " << spec;
+    out << "\n";
+    out << "Index,Filename,Config,TP,FP,TN,FN\n";
+    for (const auto& row : rows) {
+        const Metrics& m = row.metrics;
+        out << row.index << "," << row.filename << "," << row.config << ","
+            << m.tp << "," << m.fp << "," << m.tn << "," << m.fn << "\n";
+    }
+    if (!out) {
+        throw std::runtime_error("Could not write partial results: " + filename.string());
+    }
+}
+
+static void printBatchUsage(const std::string& program) {
+    std::cerr << "Usage: " << program << " batch <input_dir|manifest> <output_dir> [algorithm_spec ...] [--jobs N] [--threads N] [--shard i/N] [--cache dir]\n";
+    std::cerr << "Algorithm specs are colon-separated, e.g. mwa:70:0.2 rle:8 ccl:40:8; join specs with | to chain them\n";
+}
+
+int runBatch(const std::vector<std::string>& args, const std::string& labelColumn, const std::string& truthColumn,
+             const std::string& contigColumn, const std::string& coordColumn, const std::string& scoreColumn) {
+    std::vector<std::string> positional;
+    int jobs = static_cast<int>(ThreadPool::shared().concurrency());
+    int threadsPerAlgorithm = 1;
+    int shard = 0, shards = 0;
+    std::string cacheDir;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (args[i] == "--jobs" && i + 1 < args.size()) jobs = std::stoi(args[++i]);
+        else if (args[i] == "--cache" && i + 1 < args.size()) cacheDir = args[++i];
+        else if (args[i] == "--threads" && i + 1 < args.size()) threadsPerAlgorithm = std::stoi(args[++i]);
+        else if (args[i] == "--shard" && i + 1 < args.size()) {
+            const std::string& value = args[++i];
+            size_t slash = value.find('/');
+            try {
+                if (slash == std::string::npos) throw std::invalid_argument(value);
+                shard = std::stoi(value.substr(0, slash));
+                shards = std::stoi(value.substr(slash + 1));
+            } catch (const std::exception&) {
+                shards = 0;
+            }
+            if (shards <= 0 || shard < 0 || shard >= shards) {
+                std::cerr << "Error: --shard expects i/N with 0 <= i < N, got " << value << "\n";
+                return 1;
+            }
+        }
+        else positional.push_back(args[i]);
+    }
+    if (positional.size() < 2) {
+        printBatchUsage(args[0]);
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    std::vector<Pipeline> configs;
+    std::unique_ptr<ResultCache> cache;
+    try {
+        if (!cacheDir.empty()) cache = std::make_unique<ResultCache>(cacheDir);
+        files = collectInputFiles(positional[0]);
+        for (size_t i = 2; i < positional.size(); ++i) configs.push_back(parsePipelineSpec(positional[i]));
+        if (configs.empty()) {
+            for (const char* spec : DEFAULT_BATCH_ALGORITHMS) configs.push_back(parsePipelineSpec(spec));
+        }
+        fs::create_directories(positional[1]);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    bool needsScores = std::any_of(configs.begin(), configs.end(),
+                                   [](const Pipeline& pipeline) { return readsScores(pipeline[0].name); });
+    bool needsCoords = false;
+    try {
+        needsCoords = std::any_of(configs.begin(), configs.end(), [](const Pipeline& pipeline) { return usesBasePairs(pipeline); });
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::vector<std::string> specs;
+    for (const auto& config : configs) specs.push_back(pipelineSpec(config));
+
+    // Everything besides the file and the spec that changes a result
+    std::vector<std::string> cacheContexts;
+    for (const auto& config : configs) {
+        cacheContexts.push_back("batch;label=" + labelColumn + ";truth=" + truthColumn + ";contig=" + contigColumn +
+                                (readsScores(config[0].name) ? ";score=" + scoreColumn : "") +
+                                (usesBasePairs(config) ? ";coord=" + coordColumn : ""));
+    }
+
+    // A shard runs only its part of the list; indexes stay those of the full list
+    std::vector<size_t> selected;
+    if (shards > 0) {
+        selected = shardFiles(files, shard, shards);
+    } else {
+        for (size_t i = 0; i < files.size(); ++i) selected.push_back(i);
+    }
+
+    // results[file][config]; a file whose load failed keeps ok == false
+    struct FileResult {
+        bool ok = false;
+        std::vector<Metrics> metrics;
+    };
+    std::vector<FileResult> results(files.size());
+    std::mutex logMutex;
+
+    // Each genome is parsed once and every configuration runs on the in-memory labels.
+    // Files and the algorithms inside them share the process-wide pool.
+    ThreadPool::shared().forEachIndex(selected.size(), jobs, [&](size_t s) {
+        size_t i = selected[s];
+        try {
+            // With a cache the file is only hashed, and parsed only if some configuration missed
+            std::vector<std::string> keys(configs.size());
+            std::vector<bool> cached(configs.size(), false);
+            results[i].metrics.resize(configs.size());
+            size_t hits = 0;
+            if (cache) {
+                std::string inputHash = hashFile(files[i]);
+                for (size_t c = 0; c < configs.size(); ++c) {
+                    keys[c] = ResultCache::key(inputHash, cacheContexts[c], specs[c]);
+                    cached[c] = cache->lookup(keys[c], &results[i].metrics[c]);
+                    hits += cached[c];
+                }
+            }
+
+            if (hits < configs.size()) {
+                LabelTrack track = readLabelTrack(files[i], labelColumn, truthColumn, contigColumn,
+                                                  needsCoords ? coordColumn : "", needsScores ? scoreColumn : "");
+                if (track.trueLabels.empty()) {
+                    throw std::runtime_error("no '" + truthColumn + "' column");
+                }
+                for (size_t c = 0; c < configs.size(); ++c) {
+                    if (cached[c]) continue;
+                    BitLabels output = runPipelineByContig(configs[c], track, threadsPerAlgorithm);
+                    results[i].metrics[c] = computeMetrics(track.trueLabels, output);
+                    if (cache) cache->store(keys[c], results[i].metrics[c], &output, &track.contigs);
+                }
+            }
+            results[i].ok = true;
+
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cout << "Processed " << fs::path(files[i]).filename().string();
+            if (cache) std::cout << " (" << hits << " of " << configs.size() << " cached)";
+            std::cout << "\n";
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cerr << "Error processing file " << files[i] << ": " << e.what() << "\n";
+        }
+    });
+
+    fs::path outputDir(positional[1]);
+    std::vector<BatchRow> rows;
+    size_t processed = 0;
+    for (size_t i : selected) {
+        if (!results[i].ok) continue;
+        ++processed;
+        for (size_t c = 0; c < configs.size(); ++c) {
+            rows.push_back({i, fs::path(files[i]).filename().string(), c, results[i].metrics[c]});
+        }
+    }
+
+    if (cache) {
+        cache->recordRun("batch");
+        std::cout << "Cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    }
+
+    try {
+        if (shards > 0) {
+            fs::path partial = outputDir / partialFileName(shard, shards);
+            writePartial(partial, shard, shards, files.size(), selected.size(), specs, rows);
+            std::cout << "Shard " << shard << "/" << shards << " complete: " << processed << " of " << selected.size()
+                      << " files. Partial results are in " << partial.string() << "\n";
+            return processed == selected.size() ? 0 : 1;
+        }
+        writeBatchTables(outputDir, specs, rows);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::cout << "Batch complete: " << processed << " of " << files.size() << " files. Results are in "
+              << (outputDir / "results_table.csv").string() << " and " << (outputDir / "final_averages.csv").string() << "\n";
+    return processed == files.size() ? 0 : 1;
+}
+
+// Reads one partial file written by batch --shard
+struct Partial {
+    int shard = -1, shards = 0;
+    size_t totalFiles = 0, assignedFiles = 0;
+    std::vector<std::string> specs;
+    std::vector<BatchRow> rows;
+};
+
+static Partial readPartial(const fs::path& filename) {
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+        throw std::runtime_error("Could not open partial results: " + filename.string());
+    }
+    auto malformed = [&](const std::string& line) {
+        return std::runtime_error(filename.string() + ": malformed line: " + line);
+    };
+
+    Partial partial;
+    std::string line;
+    bool header = false;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (line[0] == '#') {
+            std::istringstream fields(line.substr(1));
+            std::string key;
+            fields >> key;
+            if (key == "shard") {
+                char slash = 0;
+                if (!(fields >> partial.shard >> slash >> partial.shards) || slash != '/') throw malformed(line);
+            } else if (key == "files") {
+                if (!(fields >> partial.totalFiles >> partial.assignedFiles)) throw malformed(line);
+            } else if (key == "algorithms") {
+                std::string spec;
+                while (fields >> spec) partial.specs.push_back(spec);
+            }
+            continue;
+        }
+        if (!header) {
+            header = true;
+            continue;
+        }
+
+        // Index,Filename,Config,TP,FP,TN,FN; the filename is everything between
+        // the first comma and the last five fields
+        std::vector<std::string> fields;
+        std::istringstream iss(line);
+        std::string field;
+        while (std::getline(iss, field, ',')) fields.push_back(field);
+        if (fields.size() < 7) throw malformed(line);
+        BatchRow row;
+        try {
+            size_t n = fields.size();
+            row.index = std::stoull(fields[0]);
+            for (size_t f = 1; f + 5 < n; ++f) row.filename += (f > 1 ? "," : "") + fields[f];
+            row.config = std::stoull(fields[n - 5]);
+            row.metrics = metricsFromCounts(std::stoll(fields[n - 4]), std::stoll(fields[n - 3]),
+                                            std::stoll(fields[n - 2]), std::stoll(fields[n - 1]));
+        } catch (const std::exception&) {
+            throw malformed(line);
+        }
+        if (row.config >= partial.specs.size()) throw malformed(line);
+        partial.rows.push_back(std::move(row));
+    }
+    if (partial.shards <= 0 || partial.shard < 0 || partial.shard >= partial.shards || partial.specs.empty()) {
+        throw std::runtime_error(filename.string() + " is not a batch --shard partial result");
+    }
+    return partial;
+}
+
+int runMerge(const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        std::cerr << "Usage: " << args[0] << " merge <partial_dir> [output_dir]\n";
+        std::cerr << "Reduces the shard_<i>_of_<N>.csv files written by batch --shard into the batch tables\n";
+        return 1;
+    }
+    fs::path partialDir(args[2]);
+    fs::path outputDir(args.size() > 3 ? args[3] : args[2]);
+
+    std::vector<BatchRow> rows;
+    std::vector<std::string> specs;
+    size_t totalFiles = 0, assignedFiles = 0;
+    try {
+        std::map<int, Partial> partials;
+        int shards = 0;
+        for (const auto& entry : fs::directory_iterator(partialDir)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind("shard_", 0) != 0 || entry.path().extension() != ".csv") continue;
+            Partial partial = readPartial(entry.path());
+            if (partials.empty()) {
+                shards = partial.shards;
+                specs = partial.specs;
+                totalFiles = partial.totalFiles;
+            } else if (partial.shards != shards || partial.specs != specs || partial.totalFiles != totalFiles) {
+                throw std::runtime_error(name + " comes from a different batch run than the other shards");
+            }
+            if (partials.count(partial.shard)) {
+                throw std::runtime_error("shard " + std::to_string(partial.shard) + " appears twice in " + partialDir.string());
+            }
+            partials.emplace(partial.shard, std::move(partial));
+        }
+        if (partials.empty()) {
+            throw std::runtime_error("no shard_<i>_of_<N>.csv files in " + partialDir.string());
+        }
+        for (int s = 0; s < shards; ++s) {
+            if (!partials.count(s)) {
+                throw std::runtime_error("missing " + partialFileName(s, shards) + " in " + partialDir.string());
+            }
+        }
+
+        for (auto& entry : partials) {
+            assignedFiles += entry.second.assignedFiles;
+            for (auto& row : entry.second.rows) rows.push_back(std::move(row));
+        }
+        if (assignedFiles != totalFiles) {
+            throw std::runtime_error("shards cover " + std::to_string(assignedFiles) + " of " +
+                                     std::to_string(totalFiles) + " files; were they run on the same input list?");
+        }
+        std::stable_sort(rows.begin(), rows.end(), [](const BatchRow& a, const BatchRow& b) {
+            return a.index != b.index ? a.index < b.index : a.config < b.config;
+        });
+
+        fs::create_directories(outputDir);
+        writeBatchTables(outputDir, specs, rows);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    size_t processed = 0;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        if (r == 0 || rows[r].index != rows[r - 1].index) ++processed;
+    }
+    std::cout << "Merge complete: " << processed << " of " << totalFiles << " files. Results are in "
+              << (outputDir / "results_table.csv").string() << " and " << (outputDir / "final_averages.csv").string() << "\n";
+    return processed == totalFiles ? 0 : 1;
+}
+
+int runCacheStats(const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        std::cerr << "Usage: " << args[0] << " cache-stats <cache_dir>\n";
+        return 1;
+    }
+    CacheStats stats;
+    try {
+        stats = readCacheStats(args[2]);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    long long lookups = stats.hits + stats.misses;
+    std::cout << "Cache " << args[2] << ": " << stats.entries << " results (" << stats.labelFiles
+              << " with labels), " << stats.bytes << " bytes\n";
+    std::cout << "Runs: " << stats.runs << ", " << stats.hits << " hits, " << stats.misses << " misses";
+    if (lookups > 0) std::cout << " (hit rate " << static_cast<double>(stats.hits) / lookups << ")";
+    std::cout << "\n";
+    if (!stats.recentRuns.empty()) {
+        std::cout << "Recent runs (time,command,hits,misses):\n";
+        for (const auto& run : stats.recentRuns) std::cout << "  " << run << "\n";
+    }
+    return 0;
+}
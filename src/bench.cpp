@@ -0,0 +1,299 @@
+// bench.cpp
+
+#include "prophage_signal_processor.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <random>
+#include <unistd.h>
+#include "prediction_parser.h"
+#include "prediction_writer.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+// Same configurations as batch mode and slurm_scripts/run_psp_all.sh
+static const char* DEFAULT_BENCH_ALGORITHMS[] = {"mwa:70:0.2", "rle:8", "dbscan:50:20", "median:50", "ccl:40:8"};
+static const char* DEFAULT_BENCH_SIZES = "1e4,1e5,1e6,1e7,1e8";
+
+// One timed measurement. bytes is the file size for I/O cases and the
+// packed label bytes scanned for algorithm cases.
+struct BenchResult {
+    std::string name, input;
+    size_t windows = 0, bytes = 0;
+    int threads = 1;
+    double seconds = 0, meanSeconds = 0;
+    long peakRssKb = 0;
+};
+
+// Runs fn repeat times and keeps the fastest, which is the least disturbed
+// by other load on a shared node; the mean is reported alongside it
+template <typename Fn>
+static BenchResult timeCase(const std::string& name, const std::string& input, size_t windows, size_t bytes,
+                            int threads, int repeat, Fn&& fn) {
+    BenchResult result{name, input, windows, bytes, threads};
+    resetPeakRss();
+    double total = 0;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        total += elapsed.count();
+        result.seconds = (r == 0) ? elapsed.count() : std::min(result.seconds, elapsed.count());
+    }
+    result.meanSeconds = total / repeat;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+// Prophage-like labels: sparse false-positive 1s on a 0 background, with
+// islands of mostly-1 windows a few thousand windows long
+static BitLabels syntheticLabels(size_t windows, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<size_t> islandLength(300, 3000);
+    BitLabels labels(windows);
+    size_t islandEnd = 0;
+    for (size_t i = 0; i < windows; ++i) {
+        if (i >= islandEnd && uniform(rng) < 1.0 / 20000) islandEnd = i + islandLength(rng);
+        double rate = (i < islandEnd) ? 0.85 : 0.03;
+        if (uniform(rng) < rate) labels.set(i);
+    }
+    return labels;
+}
+
+// Writes labels as raw inference output, with prob_1 on the matching side of 0.5
+static void writeSyntheticPredictions(const std::string& filename, const BitLabels& labels, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> half(0.0, 0.5);
+    std::ofstream out(filename, std::ios::binary);
+    std::string buffer = "SeqID,prediction\n";
+    buffer.reserve(OUTPUT_BLOCK_SIZE + 256);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        double prob1 = half(rng) + (labels.get(i) ? 0.5 : 0.0);
+        buffer += std::to_string(i + 1);
+        buffer += ",[";
+        append_double(buffer, 1.0 - prob1);
+        buffer += ", ";
+        append_double(buffer, prob1);
+        buffer += "]\n";
+        if (buffer.size() >= OUTPUT_BLOCK_SIZE) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    if (!out) {
+        throw std::runtime_error("Could not write " + filename);
+    }
+}
+
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> values;
+    std::istringstream iss(list);
+    std::string value;
+    while (std::getline(iss, value, ',')) {
+        if (!value.empty()) values.push_back(value);
+    }
+    return values;
+}
+
+static std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static void printUsage(const std::string& program) {
+    std::cerr << "Usage: " << program << " bench <output_json|-> [algorithm_spec ...] [--sizes 1e4,1e6] [--threads 1,2,4]\n"
+              << "       [--repeat N] [--data data_dir] [--scratch dir] [--seed N]\n";
+}
+
+// Benchmarks one input, given as raw inference files: process_predictions_csv
+// over them, readCSV of its output, every algorithm at every thread count on
+// the labels read, and writeCSV of those labels
+static void benchInput(const std::string& input, const std::vector<std::string>& rawFiles,
+                       const std::vector<Pipeline>& configs, const std::vector<int>& threadCounts,
+                       int repeat, const fs::path& scratch, std::ostream& log, std::vector<BenchResult>& results) {
+    auto report = [&](const BenchResult& r) {
+        log << "  " << r.name << " threads=" << r.threads << ": " << r.seconds << " s, "
+            << r.windows / r.seconds / 1e6 << " M windows/s, "
+            << r.bytes / r.seconds / 1e6 << " MB/s, peak RSS " << r.peakRssKb / 1024 << " MB\n";
+        results.push_back(r);
+    };
+    log << input << " (" << rawFiles.size() << " file" << (rawFiles.size() == 1 ? "" : "s") << ")\n";
+
+    std::vector<std::string> processed;
+    size_t rawBytes = 0;
+    for (size_t i = 0; i < rawFiles.size(); ++i) {
+        processed.push_back((scratch / ("processed_" + std::to_string(i) + ".csv")).string());
+        rawBytes += fs::file_size(rawFiles[i]);
+    }
+
+    auto processAll = [&]() {
+        for (size_t i = 0; i < rawFiles.size(); ++i) process_predictions_csv(rawFiles[i], processed[i]);
+    };
+    processAll();
+    size_t processedBytes = 0;
+    for (const auto& file : processed) processedBytes += fs::file_size(file);
+
+    std::vector<std::vector<int>> parts(processed.size());
+    auto readAll = [&]() {
+        for (size_t i = 0; i < processed.size(); ++i) parts[i] = readCSV(processed[i], "predicted_label", "").first;
+    };
+    readAll();
+
+    // Labels of all files end to end; algorithm time does not depend on
+    // where one genome stops
+    BitLabels labels;
+    for (const auto& part : parts) {
+        for (int value : part) labels.push_back(value != 0);
+    }
+    size_t windows = labels.size();
+
+    report(timeCase("process_predictions_csv", input, windows, rawBytes, 1, repeat, processAll));
+    report(timeCase("readCSV", input, windows, processedBytes, 1, repeat, readAll));
+
+    size_t labelBytes = (windows + 7) / 8;
+    for (const auto& config : configs) {
+        for (int threads : threadCounts) {
+            report(timeCase(pipelineSpec(config), input, windows, labelBytes, threads, repeat, [&]() {
+                BitLabels output = runPipelineByContig(config, labels, {}, threads);
+                if (output.size() != windows) throw std::runtime_error(pipelineSpec(config) + " changed the track length");
+            }));
+        }
+    }
+
+    std::string written = (scratch / "written.csv").string();
+    auto writeAll = [&]() { writeCSV(written, labels); };
+    writeAll();
+    report(timeCase("writeCSV", input, windows, fs::file_size(written), 1, repeat, writeAll));
+
+    for (const auto& file : processed) fs::remove(file);
+    fs::remove(written);
+}
+
+int runBench(const std::vector<std::string>& args) {
+    std::vector<std::string> positional;
+    std::string sizeList = DEFAULT_BENCH_SIZES;
+    std::string threadList;
+    std::string dataDir = "../data";
+    std::string scratchDir = fs::temp_directory_path().string();
+    int repeat = 3;
+    uint64_t seed = 1;
+    try {
+        for (size_t i = 2; i < args.size(); ++i) {
+            if (args[i] == "--sizes" && i + 1 < args.size()) sizeList = args[++i];
+            else if (args[i] == "--threads" && i + 1 < args.size()) threadList = args[++i];
+            else if (args[i] == "--repeat" && i + 1 < args.size()) repeat = std::max(1, std::stoi(args[++i]));
+            else if (args[i] == "--data" && i + 1 < args.size()) dataDir = args[++i];
+            else if (args[i] == "--scratch" && i + 1 < args.size()) scratchDir = args[++i];
+            else if (args[i] == "--seed" && i + 1 < args.size()) seed = std::stoull(args[++i]);
+            else positional.push_back(args[i]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: invalid option value: " << e.what() << "\n";
+        return 1;
+    }
+    if (positional.empty()) {
+        printUsage(args[0]);
+        return 1;
+    }
+
+    std::vector<Pipeline> configs;
+    std::vector<size_t> sizes;
+    std::vector<int> threadCounts;
+    try {
+        if (positional.size() > 1) {
+            for (size_t i = 1; i < positional.size(); ++i) configs.push_back(parsePipelineSpec(positional[i]));
+        } else {
+            for (const char* spec : DEFAULT_BENCH_ALGORITHMS) configs.push_back(parsePipelineSpec(spec));
+        }
+        for (const auto& size : splitList(sizeList)) {
+            double windows = std::stod(size);
+            if (windows < 1) throw std::invalid_argument("benchmark sizes must be at least 1 window: " + size);
+            sizes.push_back(static_cast<size_t>(windows));
+        }
+        for (const auto& count : splitList(threadList)) threadCounts.push_back(std::max(1, std::stoi(count)));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    // Default thread counts double from 1 up to the pool's concurrency
+    int concurrency = static_cast<int>(ThreadPool::shared().concurrency());
+    if (threadCounts.empty()) {
+        for (int t = 1; t < concurrency; t *= 2) threadCounts.push_back(t);
+        threadCounts.push_back(concurrency);
+    }
+
+    // Progress goes to stderr when the JSON itself goes to stdout
+    std::ostream& log = (positional[0] == "-") ? std::cerr : std::cout;
+    fs::path scratch = fs::path(scratchDir) / ("psp_bench_" + std::to_string(::getpid()));
+    std::vector<BenchResult> results;
+    try {
+        fs::create_directories(scratch);
+
+        fs::path rawDir = fs::path(dataDir) / "raw_inference_data";
+        if (fs::is_directory(rawDir)) {
+            std::vector<std::string> rawFiles;
+            for (const auto& file : collectInputFiles(rawDir.string())) {
+                if (is_prediction_file(file)) rawFiles.push_back(file);
+            }
+            if (!rawFiles.empty()) benchInput(rawDir.string(), rawFiles, configs, threadCounts, repeat, scratch, log, results);
+        } else {
+            log << "No " << rawDir.string() << "; benchmarking synthetic inputs only\n";
+        }
+
+        for (size_t windows : sizes) {
+            std::string raw = (scratch / "synthetic.csv").string();
+            writeSyntheticPredictions(raw, syntheticLabels(windows, seed), seed + 1);
+            benchInput("synthetic:" + std::to_string(windows), {raw}, configs, threadCounts, repeat, scratch, log, results);
+            fs::remove(raw);
+        }
+        fs::remove_all(scratch);
+    } catch (const std::exception& e) {
+        std::error_code ignored;
+        fs::remove_all(scratch, ignored);
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::ofstream file;
+    if (positional[0] != "-") {
+        file.open(positional[0]);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open output file: " << positional[0] << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = (positional[0] == "-") ? std::cout : file;
+
+    // One object per run, so files from different versions can be diffed or
+    // loaded side by side
+    out << "{\n  \"timestamp\": " << static_cast<long long>(std::time(nullptr))
+        << ",\n  \"compiler\": " << jsonString(__VERSION__)
+        << ",\n  \"concurrency\": " << concurrency
+        << ",\n  \"repeat\": " << repeat
+        << ",\n  \"peak_rss_per_case\": " << (resetPeakRss() ? "true" : "false")
+        << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    {\"name\": " << jsonString(r.name) << ", \"input\": " << jsonString(r.input)
+            << ", \"windows\": " << r.windows << ", \"bytes\": " << r.bytes << ", \"threads\": " << r.threads
+            << ", \"seconds\": " << r.seconds << ", \"mean_seconds\": " << r.meanSeconds
+            << ", \"windows_per_second\": " << (r.seconds > 0 ? r.windows / r.seconds : 0)
+            << ", \"bytes_per_second\": " << (r.seconds > 0 ? r.bytes / r.seconds : 0)
+            << ", \"peak_rss_kb\": " << r.peakRssKb << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,68 @@
+// bit_algorithms.cpp
+
+#include "prophage_signal_processor.h"
+#include <algorithm>
+#include <stdexcept>
+#include "thread_pool.h"
+
+// Splits [0, numWords) into contiguous ranges on the shared pool. Output words
+// are never shared between ranges, so kernels can write them without locking.
+template <typename Fn>
+static void forWordChunks(size_t numWords, int numThreads, Fn&& fn) {
+    ThreadPool::shared().parallelFor(0, numWords, 64, numThreads, [&](size_t, size_t start, size_t end) { fn(start, end); });
+}
+
+// Each chunk of output words runs the shared window count over its own
+// windows, so the output is the same for every thread count.
+static BitLabels windowCountFilter(const BitLabels& input, const WindowCount& window, int numThreads) {
+    BitLabels output(input.size());
+    BitSpan<uint64_t> out = bitSpan(output);
+    forWordChunks(output.words().size(), numThreads, [&](size_t wordBegin, size_t wordEnd) {
+        windowCountRange(bitSpan(input), out, window, static_cast<long long>(wordBegin) * 64,
+                         static_cast<long long>(wordEnd) * 64);
+    });
+    return output;
+}
+
+BitLabels movingWindowAverage(const BitLabels& input, int windowSize, double threshold, int numThreads) {
+    return windowCountFilter(input, mwaWindowCount(input.size(), windowSize, threshold), numThreads);
+}
+
+BitLabels medianFilter(const BitLabels& input, int windowSize, int numThreads) {
+    return windowCountFilter(input, medianWindowCount(input.size(), windowSize), numThreads);
+}
+
+// Run-based kernels touch only run boundaries and the words they fill, so
+// each call scans sequentially and numThreads is accepted for a uniform
+// interface. runAlgorithmByContig cuts long inputs at runs of 0s that no run,
+// component or chain spans and runs the pieces on separate threads.
+BitLabels runLengthEncoding(const BitLabels& input, int minLength, int) {
+    BitLabels output(input.size());
+    runLengthEncodingInto(bitSpan(input), bitSpan(output), minLength);
+    return output;
+}
+
+BitLabels connectedComponentLabeling(const BitLabels& input, int minSize, int gapTolerance, int) {
+    BitLabels output(input.size());
+    connectedComponentLabelingInto(bitSpan(input), bitSpan(output), minSize, gapTolerance);
+    return output;
+}
+
+BitLabels dbscan(const BitLabels& input, int eps, int minPts, int) {
+    BitLabels output(input.size());
+    dbscanInto(bitSpan(input), bitSpan(output), eps, minPts);
+    return output;
+}
+
+Metrics computeMetrics(const BitLabels& trueLabels, const BitLabels& labels) {
+    const auto& truth = trueLabels.words();
+    const auto& predicted = labels.words();
+    long long tp = 0, fp = 0, fn = 0;
+    for (size_t w = 0; w < truth.size(); ++w) {
+        tp += BitLabels::popcount(truth[w] & predicted[w]);
+        fp += BitLabels::popcount(~truth[w] & predicted[w]);
+        fn += BitLabels::popcount(truth[w] & ~predicted[w]);
+    }
+    long long tn = static_cast<long long>(trueLabels.size()) - tp - fp - fn;
+    return metricsFromCounts(tp, fp, tn, fn);
+}
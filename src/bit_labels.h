@@ -0,0 +1,172 @@
+// bit_labels.h
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 0/1 labels packed 64 windows per word. Bits past size() in the last word
+// are always zero, so whole-word popcounts never need a tail mask.
+class BitLabels {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    BitLabels() = default;
+    explicit BitLabels(size_t size) : size_(size), words_((size + 63) / 64, 0) {}
+
+    static BitLabels fromInts(const std::vector<int>& values) {
+        BitLabels bits(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i] == 1) bits.set(i);
+        }
+        return bits;
+    }
+
+    std::vector<int> toInts() const {
+        std::vector<int> values(size_);
+        for (size_t i = 0; i < size_; ++i) values[i] = get(i) ? 1 : 0;
+        return values;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t memoryBytes() const { return words_.size() * sizeof(uint64_t); }
+
+    std::vector<uint64_t>& words() { return words_; }
+    const std::vector<uint64_t>& words() const { return words_; }
+
+    bool get(size_t i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+    void set(size_t i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+
+    void reserve(size_t size) { words_.reserve((size + 63) / 64); }
+    void push_back(bool value) {
+        if ((size_ & 63) == 0) words_.push_back(0);
+        if (value) words_.back() |= uint64_t(1) << (size_ & 63);
+        ++size_;
+    }
+
+    // Number of 1s in [begin, end)
+    size_t count(size_t begin, size_t end) const {
+        if (begin >= end) return 0;
+        size_t first = begin >> 6, last = (end - 1) >> 6;
+        if (first == last) return popcount(words_[first] & rangeMask(begin & 63, ((end - 1) & 63) + 1));
+        size_t total = popcount(words_[first] & (~uint64_t(0) << (begin & 63)));
+        for (size_t w = first + 1; w < last; ++w) total += popcount(words_[w]);
+        return total + popcount(words_[last] & rangeMask(0, ((end - 1) & 63) + 1));
+    }
+    size_t count() const { return count(0, size_); }
+
+    // Sets every bit in [begin, end)
+    void fill(size_t begin, size_t end) {
+        applyRange(begin, end, [](uint64_t& word, uint64_t mask) { word |= mask; });
+    }
+
+    // Copies source's bits in [begin, end) into this (which must hold 0s there)
+    void copyRange(const BitLabels& source, size_t begin, size_t end) {
+        const uint64_t* src = source.words_.data();
+        uint64_t* base = words_.data();
+        applyRange(begin, end, [&](uint64_t& word, uint64_t mask) { word |= src[&word - base] & mask; });
+    }
+
+    // The 64 bits starting at pos, with 0s past size()
+    uint64_t wordAt(size_t pos) const {
+        size_t w = pos >> 6, shift = pos & 63;
+        if (w >= words_.size()) return 0;
+        uint64_t word = words_[w] >> shift;
+        if (shift && w + 1 < words_.size()) word |= words_[w + 1] << (64 - shift);
+        return word;
+    }
+
+    // Copy of the bits in [begin, end)
+    BitLabels slice(size_t begin, size_t end) const {
+        BitLabels result(end - begin);
+        for (size_t w = 0; w < result.words_.size(); ++w) result.words_[w] = wordAt(begin + w * 64);
+        if (result.size_ & 63) result.words_.back() &= (uint64_t(1) << (result.size_ & 63)) - 1;
+        return result;
+    }
+
+    // Copies source's bits from sourceBegin on into [begin, end) of this
+    // (which must hold 0s there); the ranges need not share an alignment
+    void copyFrom(size_t begin, size_t end, const BitLabels& source, size_t sourceBegin) {
+        uint64_t* base = words_.data();
+        applyRange(begin, end, [&](uint64_t& word, uint64_t mask) {
+            long long from = static_cast<long long>((&word - base) * 64 + sourceBegin) - static_cast<long long>(begin);
+            uint64_t bits = from >= 0 ? source.wordAt(static_cast<size_t>(from)) : source.wordAt(0) << -from;
+            word |= bits & mask;
+        });
+    }
+
+    // Position of the first 1 (or 0) at or after pos, or size() if there is none
+    size_t findNextOne(size_t pos) const { return findNext(pos, 0); }
+    size_t findNextZero(size_t pos) const { return findNext(pos, ~uint64_t(0)); }
+
+    static size_t popcount(uint64_t word) { return static_cast<size_t>(__builtin_popcountll(word)); }
+
+private:
+    // Bits [lo, hi) of a word, 0 <= lo < hi <= 64
+    static uint64_t rangeMask(size_t lo, size_t hi) {
+        uint64_t upper = (hi == 64) ? ~uint64_t(0) : ((uint64_t(1) << hi) - 1);
+        return upper & (~uint64_t(0) << lo);
+    }
+
+    template <typename Fn>
+    void applyRange(size_t begin, size_t end, Fn&& fn) {
+        if (begin >= end) return;
+        size_t first = begin >> 6, last = (end - 1) >> 6;
+        if (first == last) {
+            fn(words_[first], rangeMask(begin & 63, ((end - 1) & 63) + 1));
+            return;
+        }
+        fn(words_[first], ~uint64_t(0) << (begin & 63));
+        for (size_t w = first + 1; w < last; ++w) fn(words_[w], ~uint64_t(0));
+        fn(words_[last], rangeMask(0, ((end - 1) & 63) + 1));
+    }
+
+    // Scans for the first bit differing from flip's bits, using count-trailing-zeros per word
+    size_t findNext(size_t pos, uint64_t flip) const {
+        if (pos >= size_) return size_;
+        size_t w = pos >> 6;
+        uint64_t word = (words_[w] ^ flip) & (~uint64_t(0) << (pos & 63));
+        while (true) {
+            if (word) {
+                size_t found = (w << 6) + static_cast<size_t>(__builtin_ctzll(word));
+                return found < size_ ? found : size_;
+            }
+            if (++w >= words_.size()) return size_;
+            word = words_[w] ^ flip;
+        }
+    }
+
+    size_t size_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+// Cumulative popcount per word, so the number of 1s before any position is
+// one table lookup plus one popcount.
+class BitRank {
+public:
+    explicit BitRank(const BitLabels& bits) : bits_(bits), prefix_(bits.words().size() + 1, 0) {
+        const auto& words = bits.words();
+        for (size_t w = 0; w < words.size(); ++w) prefix_[w + 1] = prefix_[w] + BitLabels::popcount(words[w]);
+    }
+
+    // Number of 1s in [0, i), for 0 <= i <= size()
+    size_t rank(size_t i) const {
+        size_t w = i >> 6, bit = i & 63;
+        size_t partial = bit ? BitLabels::popcount(bits_.words()[w] & ((uint64_t(1) << bit) - 1)) : 0;
+        return prefix_[w] + partial;
+    }
+
+    // Number of 1s in [begin, end) with both ends clamped to the label range
+    size_t count(long long begin, long long end) const {
+        long long n = static_cast<long long>(bits_.size());
+        begin = begin < 0 ? 0 : begin > n ? n : begin;
+        end = end < 0 ? 0 : end > n ? n : end;
+        return end > begin ? rank(static_cast<size_t>(end)) - rank(static_cast<size_t>(begin)) : 0;
+    }
+
+private:
+    const BitLabels& bits_;
+    std::vector<size_t> prefix_;
+};
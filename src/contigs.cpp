@@ -0,0 +1,155 @@
+// contigs.cpp
+
+#include "prophage_signal_processor.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include "sparse_track.h"
+#include "thread_pool.h"
+
+// Contigs up to this many windows run whole on one worker; longer ones are
+// cut into pieces of about this size
+constexpr size_t CONTIG_GRAIN = size_t(1) << 18;
+
+// How a contig can be cut without changing its output. Window filters read
+// halo extra windows on each side of a piece. Run-based algorithms are cut
+// only after separator consecutive 0s, which no run, component or chain spans.
+struct SplitRule {
+    size_t halo = 0;
+    size_t separator = 0;
+};
+
+static SplitRule splitRule(const AlgorithmConfig& config) {
+    auto param = [&](size_t i) { return i < config.params.size() ? std::max(0, std::stoi(config.params[i])) : 0; };
+    SplitRule rule;
+    if (config.name == "mwa" || config.name == "pmwa" || config.name == "median") rule.halo = param(0);
+    else if (config.name == "rle") rule.separator = 1;
+    else if (config.name == "ccl") rule.separator = param(1) + 1;
+    else if (config.name == "dbscan") rule.separator = param(0);
+    else throw std::invalid_argument("Unknown algorithm: " + config.name);
+    return rule;
+}
+
+// Output rows [begin, end), computed from input rows [computeBegin, computeEnd)
+struct Piece {
+    size_t begin, end, computeBegin, computeEnd;
+};
+
+// First x >= target (or contigEnd) such that [x - separator, x) is all 0s
+// inside the contig
+static size_t nextCut(const BitLabels& input, size_t target, size_t contigBegin, size_t contigEnd, size_t separator) {
+    if (separator == 0 || target >= contigEnd) return std::min(target, contigEnd);
+    size_t p = std::max(contigBegin, target >= separator ? target - separator : 0);
+    while (p < contigEnd) {
+        size_t zero = input.findNextZero(p);
+        if (zero >= contigEnd) break;
+        size_t one = std::min(input.findNextOne(zero), contigEnd);
+        if (one - zero >= separator) return zero + separator;
+        p = one;
+    }
+    return contigEnd;
+}
+
+static std::vector<Piece> splitContigs(const BitLabels& input, const std::vector<ContigRange>& contigs, const SplitRule& rule) {
+    std::vector<Piece> pieces;
+    for (const auto& contig : contigs) {
+        size_t begin = contig.begin;
+        while (begin < contig.end) {
+            size_t end;
+            if (contig.end - begin <= CONTIG_GRAIN) end = contig.end;
+            else if (rule.halo) end = begin + CONTIG_GRAIN;
+            else end = nextCut(input, begin + CONTIG_GRAIN, contig.begin, contig.end, rule.separator);
+
+            size_t computeBegin = begin - std::min(rule.halo, begin - contig.begin);
+            size_t computeEnd = end + std::min(rule.halo, contig.end - end);
+            pieces.push_back({begin, end, computeBegin, computeEnd});
+            begin = end;
+        }
+    }
+    return pieces;
+}
+
+BitLabels runAlgorithmByContig(const AlgorithmConfig& config, const BitLabels& input,
+                               const std::vector<ContigRange>& contigs, int numThreads) {
+    // One short contig runs whole; anything longer is cut into pieces, so the
+    // run-based algorithms use every thread even without a contig column
+    bool whole = contigs.empty() || (contigs.size() == 1 && contigs[0].begin == 0 && contigs[0].end == input.size());
+    if (whole && input.size() <= CONTIG_GRAIN) {
+        return runAlgorithm(config, input, numThreads);
+    }
+
+    std::vector<Piece> pieces = splitContigs(input, contigs.empty() ? std::vector<ContigRange>{{"", 0, input.size()}} : contigs,
+                                             splitRule(config));
+
+    // Largest pieces first, so the long tail of small contigs fills in
+    // around them as pool threads free up
+    std::vector<size_t> order(pieces.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return pieces[a].computeEnd - pieces[a].computeBegin > pieces[b].computeEnd - pieces[b].computeBegin;
+    });
+
+    std::vector<BitLabels> results(pieces.size());
+    ThreadPool::shared().forEachIndex(order.size(), numThreads, [&](size_t i) {
+        const Piece& piece = pieces[order[i]];
+        results[order[i]] = runAlgorithm(config, input.slice(piece.computeBegin, piece.computeEnd), 1);
+    });
+
+    // Pieces can share output words, so they are stitched in one pass here
+    BitLabels output(input.size());
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        output.copyFrom(pieces[i].begin, pieces[i].end, results[i], pieces[i].begin - pieces[i].computeBegin);
+    }
+    return output;
+}
+
+BitLabels runPipelineByContig(const Pipeline& pipeline, const BitLabels& input,
+                              const std::vector<ContigRange>& contigs, int numThreads) {
+    if (pipeline.empty()) return input;
+    BitLabels output = runAlgorithmByContig(pipeline[0], input, contigs, numThreads);
+    for (size_t s = 1; s < pipeline.size(); ++s) {
+        output = runAlgorithmByContig(pipeline[s], output, contigs, numThreads);
+    }
+    return output;
+}
+
+BitLabels runScoresByContig(const AlgorithmConfig& config, const std::vector<float>& scores,
+                            const std::vector<ContigRange>& contigs, int numThreads) {
+    Algorithm algorithm = config.algorithm();
+    if (algorithm.basePairs) {
+        throw std::invalid_argument(config.spec() + ": prob_1 scores have no sparse form; give the window in windows.");
+    }
+    if (algorithm.type == ALGORITHM_HMM) {
+        return viterbiSegment(scores, contigs, algorithm.enterProbability, algorithm.exitProbability, numThreads);
+    }
+    if (algorithm.type != ALGORITHM_PMWA) {
+        throw std::invalid_argument(config.name + " clusters labels, not prob_1 scores.");
+    }
+    // Contigs own disjoint byte ranges, so they fill one buffer in parallel
+    std::vector<uint8_t> bytes(scores.size());
+    ThreadPool::shared().forEachIndex(contigs.size(), numThreads, [&](size_t c) {
+        size_t begin = contigs[c].begin, length = contigs[c].end - contigs[c].begin;
+        probabilityWindowAverageInto(Span<const float>(scores.data() + begin, length),
+                                     Span<uint8_t>(bytes.data() + begin, length), algorithm.windowSize,
+                                     algorithm.threshold);
+    });
+    BitLabels output(scores.size());
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        if (bytes[i]) output.set(i);
+    }
+    return output;
+}
+
+BitLabels runPipelineByContig(const Pipeline& pipeline, const LabelTrack& track, int numThreads) {
+    if (usesBasePairs(pipeline)) {
+        return runSparsePipeline(pipeline, track, numThreads);
+    }
+    if (pipeline.empty() || !readsScores(pipeline[0].name)) {
+        return runPipelineByContig(pipeline, track.labels, track.contigs, numThreads);
+    }
+    if (track.scores.size() != track.labels.size()) {
+        throw std::invalid_argument(pipeline[0].name + " needs prob_1 scores: raw inference output, a .pstrack or a CSV with a prob_1 column.");
+    }
+    BitLabels output = runScoresByContig(pipeline[0], track.scores, track.contigs, numThreads);
+    return runPipelineByContig(Pipeline(pipeline.begin() + 1, pipeline.end()), output, track.contigs, numThreads);
+}
@@ -0,0 +1,127 @@
+// evaluation.cpp
+
+#include "evaluation.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+static double ratio(double numerator, double denominator) {
+    return denominator > 0 ? numerator / denominator : 0.0;
+}
+
+Evaluation evaluate(const BitLabels& truth, const BitLabels& predicted,
+                    const std::vector<ContigRange>& contigs, const std::vector<long long>& coords) {
+    if (truth.size() != predicted.size()) {
+        throw std::invalid_argument("truth has " + std::to_string(truth.size()) + " windows, predictions have " +
+                                    std::to_string(predicted.size()));
+    }
+    std::vector<Interval> truthRegions = findIntervals(truth, BitLabels(), contigs, coords);
+    std::vector<Interval> predictedRegions = findIntervals(predicted, BitLabels(), contigs, coords);
+
+    Evaluation result;
+    result.matches.resize(truthRegions.size());
+    std::vector<size_t> bestMatch(truthRegions.size());
+    std::vector<size_t> bestIntersection(truthRegions.size(), 0);
+    std::vector<size_t> covered(truthRegions.size(), 0);
+    std::vector<bool> correct(predictedRegions.size(), false);
+    long long truthWindows = 0, predictedWindows = 0, intersection = 0;
+
+    // Both lists are sorted by contig then position and disjoint within each,
+    // so advancing whichever region ends first visits every overlapping pair once
+    size_t t = 0, p = 0;
+    while (t < truthRegions.size() && p < predictedRegions.size()) {
+        const Interval& a = truthRegions[t];
+        const Interval& b = predictedRegions[p];
+        if (a.contig != b.contig) {
+            (a.contig < b.contig) ? ++t : ++p;
+            continue;
+        }
+        size_t lo = std::max(a.begin, b.begin), hi = std::min(a.end, b.end);
+        if (lo < hi) {
+            size_t shared = hi - lo;
+            covered[t] += shared;
+            intersection += static_cast<long long>(shared);
+            correct[p] = true;
+            if (shared > bestIntersection[t]) {
+                bestIntersection[t] = shared;
+                bestMatch[t] = p;
+            }
+        }
+        (a.end <= b.end) ? ++t : ++p;
+    }
+
+    RegionMetrics& r = result.regions;
+    r.truthRegions = static_cast<long long>(truthRegions.size());
+    r.predictedRegions = static_cast<long long>(predictedRegions.size());
+    double coverageSum = 0, overlapSum = 0, startErrorSum = 0, endErrorSum = 0;
+    for (size_t i = 0; i < truthRegions.size(); ++i) {
+        RegionMatch& match = result.matches[i];
+        const Interval& region = truthRegions[i];
+        size_t length = region.end - region.begin;
+        match.truth = region;
+        match.coverage = ratio(covered[i], length);
+        truthWindows += static_cast<long long>(length);
+        if (bestIntersection[i] > 0) {
+            const Interval& best = predictedRegions[bestMatch[i]];
+            match.detected = true;
+            match.overlap = ratio(bestIntersection[i], length + (best.end - best.begin) - bestIntersection[i]);
+            match.startError = best.startCoord - region.startCoord;
+            match.endError = best.endCoord - region.endCoord;
+            ++r.detected;
+            startErrorSum += std::llabs(match.startError);
+            endErrorSum += std::llabs(match.endError);
+        }
+        coverageSum += match.coverage;
+        overlapSum += match.overlap;
+    }
+    for (size_t i = 0; i < predictedRegions.size(); ++i) {
+        predictedWindows += static_cast<long long>(predictedRegions[i].end - predictedRegions[i].begin);
+        if (correct[i]) ++r.correct;
+    }
+
+    r.recall = ratio(r.detected, r.truthRegions);
+    r.precision = ratio(r.correct, r.predictedRegions);
+    r.f1 = ratio(2 * r.precision * r.recall, r.precision + r.recall);
+    r.meanCoverage = ratio(coverageSum, r.truthRegions);
+    r.meanOverlap = ratio(overlapSum, r.truthRegions);
+    r.meanAbsStartError = ratio(startErrorSum, r.detected);
+    r.meanAbsEndError = ratio(endErrorSum, r.detected);
+
+    // Window counts fall out of the same merge: the overlap is TP, the rest
+    // of each side is FN or FP
+    long long tp = intersection;
+    long long fp = predictedWindows - tp;
+    long long fn = truthWindows - tp;
+    result.windows = metricsFromCounts(tp, fp, static_cast<long long>(truth.size()) - tp - fp - fn, fn);
+    return result;
+}
+
+void printRegionMetrics(const RegionMetrics& r, std::ostream& out) {
+    out << "Regions: " << r.detected << " of " << r.truthRegions << " truth regions detected, "
+        << r.correct << " of " << r.predictedRegions << " predicted regions correct" << std::endl;
+    out << "Region recall: " << r.recall << std::endl;
+    out << "Region precision: " << r.precision << std::endl;
+    out << "Region F1: " << r.f1 << std::endl;
+    out << "Mean region coverage: " << r.meanCoverage << std::endl;
+    out << "Mean region overlap (IoU): " << r.meanOverlap << std::endl;
+    out << "Mean boundary error: " << r.meanAbsStartError << " start, " << r.meanAbsEndError << " end" << std::endl;
+}
+
+void writeRegionReport(const std::string& filename, const Evaluation& evaluation,
+                       const std::vector<ContigRange>& contigs, const std::string& defaultContig) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open region report: " + filename);
+    }
+    out << "contig,start,end,windows,detected,coverage,overlap,start_error,end_error\n";
+    for (const auto& match : evaluation.matches) {
+        const std::string& name = contigs[match.truth.contig].name;
+        out << (name.empty() ? defaultContig : name) << "," << match.truth.startCoord << "," << match.truth.endCoord << ","
+            << match.truth.end - match.truth.begin << "," << (match.detected ? 1 : 0) << "," << match.coverage << ","
+            << match.overlap << "," << match.startError << "," << match.endError << "\n";
+    }
+    if (!out) {
+        throw std::runtime_error("Could not write region report: " + filename);
+    }
+}
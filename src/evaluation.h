@@ -0,0 +1,50 @@
+// evaluation.h
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "intervals.h"
+
+// How one truth region was recovered, against the predicted region that
+// overlaps it most. Errors are predicted minus truth, in coordinate units
+// (bp with a coordinate column, windows otherwise); they are 0 when the
+// region was missed.
+struct RegionMatch {
+    Interval truth;
+    bool detected = false;
+    double coverage = 0;  // fraction of the region's windows predicted
+    double overlap = 0;   // intersection over union with the best match
+    long long startError = 0, endError = 0;
+};
+
+// Region-level scores. A truth region is detected when any predicted region
+// overlaps it; a predicted region is correct when it overlaps any truth
+// region. Ratios with an empty denominator are 0, never NaN.
+struct RegionMetrics {
+    long long truthRegions = 0, predictedRegions = 0;
+    long long detected = 0, correct = 0;
+    double recall = 0, precision = 0, f1 = 0;
+    double meanCoverage = 0, meanOverlap = 0;
+    double meanAbsStartError = 0, meanAbsEndError = 0;
+};
+
+struct Evaluation {
+    Metrics windows;
+    RegionMetrics regions;
+    std::vector<RegionMatch> matches;
+};
+
+// Converts both tracks to sorted intervals per contig and computes the
+// window confusion counts and the region metrics in one merge of the two
+// interval lists. Cost is O(n / 64) to find the intervals plus O(regions).
+Evaluation evaluate(const BitLabels& truth, const BitLabels& predicted,
+                    const std::vector<ContigRange>& contigs, const std::vector<long long>& coords);
+
+void printRegionMetrics(const RegionMetrics& r, std::ostream& out);
+
+// One CSV row per truth region: contig, coordinates, detection, coverage,
+// overlap and boundary errors.
+void writeRegionReport(const std::string& filename, const Evaluation& evaluation,
+                       const std::vector<ContigRange>& contigs, const std::string& defaultContig);
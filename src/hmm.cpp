@@ -0,0 +1,153 @@
+// hmm.cpp
+
+#include "prophage_signal_processor.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include "thread_pool.h"
+
+// Contigs decoded together, one per lane of the recurrence. Four doubles
+// fill an AVX2 register; with SSE2 the compiler uses two.
+constexpr size_t HMM_LANES = 4;
+
+// prob_1 is clamped to [floor, 1 - floor], so no single window carries more
+// than about 14 nats of evidence and 0 or 1 scores stay finite
+constexpr double HMM_PROB_FLOOR = 1e-6;
+
+// Log transition probabilities of the host (0) / prophage (1) chain
+struct Transitions {
+    double stay0, enter, exit, stay1;
+};
+
+// Viterbi over a group of up to HMM_LANES contigs. Only the score difference
+// d = V1 - V0 is carried, so a step per lane is
+//   d' = max(enter, d + stay1) - max(stay0, d + exit) + logit(p)
+// with the two comparisons as the backpointers. The forward pass stores d
+// every `block` windows; the traceback then recomputes one block at a time
+// from its checkpoint, so besides the scores only O(sqrt(n)) checkpoints and
+// backpointers are held per lane.
+class LaneGroup {
+public:
+    LaneGroup(const std::vector<float>& scores, const Transitions& t) : scores_(scores), t_(t) {}
+
+    void add(size_t begin, size_t length) {
+        begin_[lanes_] = begin;
+        length_[lanes_] = length;
+        ++lanes_;
+    }
+
+    // Appends the prophage runs of each lane as absolute [begin, end) rows
+    void decode(std::vector<std::pair<size_t, size_t>>& runs) {
+        size_t n = *std::max_element(length_, length_ + lanes_);
+        if (n == 0) return;
+        size_t block = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(n)))));
+        size_t blocks = (n + block - 1) / block;
+
+        std::vector<double> checkpoints(blocks * HMM_LANES);
+        std::vector<uint8_t> backpointers(block * HMM_LANES);
+        double d[HMM_LANES], last[HMM_LANES];
+        std::fill(d, d + HMM_LANES, -std::numeric_limits<double>::infinity());
+        std::fill(last, last + HMM_LANES, 0.0);
+
+        for (size_t b = 0; b < blocks; ++b) {
+            std::copy(d, d + HMM_LANES, &checkpoints[b * HMM_LANES]);
+            size_t end = std::min(n, (b + 1) * block);
+            for (size_t i = b * block; i < end; ++i) {
+                step(i, d, nullptr);
+                for (size_t l = 0; l < HMM_LANES; ++l) last[l] = (i + 1 == length_[l]) ? d[l] : last[l];
+            }
+        }
+
+        // Trace back from the better final state; a tie ends in host
+        uint8_t state[HMM_LANES];
+        size_t runEnd[HMM_LANES];
+        for (size_t l = 0; l < HMM_LANES; ++l) {
+            state[l] = last[l] > 0;
+            runEnd[l] = 0;
+        }
+        for (size_t b = blocks; b-- > 0;) {
+            std::copy(&checkpoints[b * HMM_LANES], &checkpoints[b * HMM_LANES] + HMM_LANES, d);
+            size_t start = b * block, end = std::min(n, start + block);
+            for (size_t i = start; i < end; ++i) step(i, d, &backpointers[(i - start) * HMM_LANES]);
+
+            for (size_t i = end; i-- > start;) {
+                for (size_t l = 0; l < lanes_; ++l) {
+                    if (i >= length_[l]) continue;
+                    uint8_t s = state[l];
+                    if (s && !runEnd[l]) runEnd[l] = i + 1;
+                    if (!s && runEnd[l]) {
+                        runs.emplace_back(begin_[l] + i + 1, begin_[l] + runEnd[l]);
+                        runEnd[l] = 0;
+                    }
+                    state[l] = (backpointers[(i - start) * HMM_LANES + l] >> s) & 1;
+                }
+            }
+        }
+        for (size_t l = 0; l < lanes_; ++l) {
+            if (runEnd[l]) runs.emplace_back(begin_[l], begin_[l] + runEnd[l]);
+        }
+    }
+
+private:
+    // One window of every lane. Lanes past their contig's end see logit 0 and
+    // their results are never read. backpointers[l] gets bit s set when the
+    // best path into state s at window i comes from state 1.
+    void step(size_t i, double* d, uint8_t* backpointers) const {
+        double logit[HMM_LANES] = {};
+        for (size_t l = 0; l < lanes_; ++l) {
+            if (i >= length_[l]) continue;
+            double p = std::min(std::max(static_cast<double>(scores_[begin_[l] + i]), HMM_PROB_FLOOR), 1.0 - HMM_PROB_FLOOR);
+            logit[l] = std::log(p / (1.0 - p));
+        }
+        for (size_t l = 0; l < HMM_LANES; ++l) {
+            double into0 = d[l] + t_.exit, into1 = d[l] + t_.stay1;
+            if (backpointers) backpointers[l] = static_cast<uint8_t>((into0 > t_.stay0) | (into1 >= t_.enter) << 1);
+            d[l] = std::max(t_.enter, into1) - std::max(t_.stay0, into0) + logit[l];
+        }
+    }
+
+    const std::vector<float>& scores_;
+    Transitions t_;
+    size_t lanes_ = 0;
+    size_t begin_[HMM_LANES] = {};
+    size_t length_[HMM_LANES] = {};
+};
+
+BitLabels viterbiSegment(const std::vector<float>& scores, const std::vector<ContigRange>& contigs,
+                         double enterProbability, double exitProbability, int numThreads) {
+    auto valid = [](double p) { return p > 0 && p < 1; };
+    if (!valid(enterProbability) || !valid(exitProbability)) {
+        throw std::invalid_argument("HMM transition probabilities must be between 0 and 1.");
+    }
+    Transitions t{std::log1p(-enterProbability), std::log(enterProbability), std::log(exitProbability),
+                  std::log1p(-exitProbability)};
+
+    // Contigs of similar length share a group, longest first, so lanes idle
+    // little and the long groups start before the short ones
+    std::vector<size_t> order(contigs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return contigs[a].end - contigs[a].begin > contigs[b].end - contigs[b].begin;
+    });
+    size_t groups = (order.size() + HMM_LANES - 1) / HMM_LANES;
+
+    std::vector<std::vector<std::pair<size_t, size_t>>> runs(groups);
+    ThreadPool::shared().forEachIndex(groups, numThreads, [&](size_t g) {
+        LaneGroup group(scores, t);
+        for (size_t i = g * HMM_LANES; i < std::min(order.size(), (g + 1) * HMM_LANES); ++i) {
+            const ContigRange& contig = contigs[order[i]];
+            group.add(contig.begin, contig.end - contig.begin);
+        }
+        group.decode(runs[g]);
+    });
+
+    // Groups may share output words, so runs are filled here in one pass
+    BitLabels output(scores.size());
+    for (const auto& group : runs) {
+        for (const auto& run : group) output.fill(run.first, run.second);
+    }
+    return output;
+}
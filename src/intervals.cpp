@@ -0,0 +1,205 @@
+// intervals.cpp
+
+#include "intervals.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "mapped_file.h"
+
+constexpr char RUNS_MAGIC[8] = {'P', 'S', 'P', 'R', 'U', 'N', 'S', '1'};
+
+std::vector<Interval> findIntervals(const BitLabels& output, const BitLabels& input,
+                                    const std::vector<ContigRange>& contigs, const std::vector<long long>& coords) {
+    if (!coords.empty() && coords.size() != output.size()) {
+        throw std::invalid_argument("coordinate column has " + std::to_string(coords.size()) + " rows, labels have " +
+                                    std::to_string(output.size()));
+    }
+
+    std::vector<Interval> intervals;
+    for (size_t c = 0; c < contigs.size(); ++c) {
+        const ContigRange& contig = contigs[c];
+        auto coordAt = [&](size_t row) -> long long {
+            return coords.empty() ? static_cast<long long>(row - contig.begin) : coords[row];
+        };
+        // Window stride at the contig end, used to close a region there
+        long long lastStride = 1;
+        if (!coords.empty() && contig.end - contig.begin >= 2) {
+            lastStride = coords[contig.end - 1] - coords[contig.end - 2];
+        }
+
+        size_t pos = contig.begin;
+        while (true) {
+            size_t begin = output.findNextOne(pos);
+            if (begin >= contig.end) break;
+            size_t end = std::min(output.findNextZero(begin), contig.end);
+
+            Interval interval;
+            interval.contig = c;
+            interval.begin = begin;
+            interval.end = end;
+            interval.startCoord = coordAt(begin);
+            interval.endCoord = (end < contig.end) ? coordAt(end) : coordAt(end - 1) + lastStride;
+            interval.score = input.empty() ? 1.0 : static_cast<double>(input.count(begin, end)) / (end - begin);
+            intervals.push_back(interval);
+            pos = end;
+        }
+    }
+    return intervals;
+}
+
+OutputFormat outputFormat(const std::string& filename) {
+    auto endsWith = [&](const char* suffix) {
+        size_t n = std::strlen(suffix);
+        return filename.size() >= n && filename.compare(filename.size() - n, n, suffix) == 0;
+    };
+    if (endsWith(".bed")) return OUTPUT_BED;
+    if (endsWith(".psruns")) return OUTPUT_RUNS;
+    return OUTPUT_LABELS;
+}
+
+void writeOutput(const std::string& filename, const BitLabels& output, const BitLabels& input,
+                 const std::vector<ContigRange>& contigs, const std::vector<long long>& coords,
+                 const std::string& defaultContig) {
+    switch (outputFormat(filename)) {
+        case OUTPUT_BED:
+            writeIntervals(filename, findIntervals(output, input, contigs, coords), contigs, defaultContig);
+            break;
+        case OUTPUT_RUNS:
+            writeRuns(filename, output, contigs);
+            break;
+        default:
+            writeCSV(filename, output);
+    }
+}
+
+void writeIntervals(const std::string& filename, const std::vector<Interval>& intervals,
+                    const std::vector<ContigRange>& contigs, const std::string& defaultContig) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open output file: " + filename);
+    }
+    std::string buffer;
+    char number[32];
+    for (const auto& interval : intervals) {
+        const std::string& name = contigs[interval.contig].name;
+        buffer += name.empty() ? defaultContig : name;
+        buffer += '\t';
+        buffer.append(number, std::to_chars(number, number + sizeof(number), interval.startCoord).ptr);
+        buffer += '\t';
+        buffer.append(number, std::to_chars(number, number + sizeof(number), interval.endCoord).ptr);
+        buffer += '\t';
+        buffer.append(number, std::to_chars(number, number + sizeof(number), interval.score, std::chars_format::general, 4).ptr);
+        buffer += '\n';
+    }
+    file.write(buffer.data(), buffer.size());
+    if (!file) {
+        throw std::runtime_error("Could not write output file: " + filename);
+    }
+}
+
+static void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+template <typename T>
+static void putRaw(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeRuns(const std::string& filename, const BitLabels& output, const std::vector<ContigRange>& contigs) {
+    std::string buffer(RUNS_MAGIC, sizeof(RUNS_MAGIC));
+    putRaw<uint64_t>(buffer, output.size());
+    putRaw<uint64_t>(buffer, contigs.size());
+    for (const auto& contig : contigs) {
+        putRaw<uint32_t>(buffer, static_cast<uint32_t>(contig.name.size()));
+        buffer += contig.name;
+        putRaw<uint64_t>(buffer, contig.begin);
+        putRaw<uint64_t>(buffer, contig.end);
+
+        std::string runs;
+        uint64_t runCount = 0;
+        size_t pos = contig.begin;
+        while (true) {
+            size_t begin = output.findNextOne(pos);
+            if (begin >= contig.end) break;
+            size_t end = std::min(output.findNextZero(begin), contig.end);
+            putVarint(runs, begin - pos);
+            putVarint(runs, end - begin);
+            ++runCount;
+            pos = end;
+        }
+        putRaw<uint64_t>(buffer, runCount);
+        buffer += runs;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(buffer.data(), buffer.size());
+    if (!file) {
+        throw std::runtime_error("Could not write output file: " + filename);
+    }
+}
+
+BitLabels readRuns(const std::string& filename, std::vector<ContigRange>* contigs) {
+    MappedFile file(filename);
+    const char* p = file.data();
+    const char* end = file.end();
+    auto fail = [&]() -> void { throw std::runtime_error(filename + ": truncated or malformed run file"); };
+    auto need = [&](size_t bytes) {
+        if (static_cast<size_t>(end - p) < bytes) fail();
+    };
+    auto getU64 = [&]() {
+        need(sizeof(uint64_t));
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return value;
+    };
+    auto getVarint = [&]() {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            need(1);
+            if (shift > 63) fail();
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+    };
+
+    need(sizeof(RUNS_MAGIC));
+    if (std::memcmp(p, RUNS_MAGIC, sizeof(RUNS_MAGIC)) != 0) {
+        throw std::runtime_error(filename + " is not a run file");
+    }
+    p += sizeof(RUNS_MAGIC);
+
+    BitLabels labels(getU64());
+    uint64_t contigCount = getU64();
+    for (uint64_t c = 0; c < contigCount; ++c) {
+        need(sizeof(uint32_t));
+        uint32_t nameLength;
+        std::memcpy(&nameLength, p, sizeof(nameLength));
+        p += sizeof(nameLength);
+        need(nameLength);
+        ContigRange contig{std::string(p, nameLength), 0, 0};
+        p += nameLength;
+        contig.begin = getU64();
+        contig.end = getU64();
+        if (contig.begin > contig.end || contig.end > labels.size()) fail();
+
+        uint64_t runCount = getU64();
+        size_t pos = contig.begin;
+        for (uint64_t r = 0; r < runCount; ++r) {
+            uint64_t gap = getVarint();
+            uint64_t length = getVarint();
+            if (gap > contig.end - pos || length > contig.end - pos - gap) fail();
+            labels.fill(pos + gap, pos + gap + length);
+            pos += gap + length;
+        }
+        if (contigs) contigs->push_back(std::move(contig));
+    }
+    return labels;
+}
@@ -0,0 +1,53 @@
+// intervals.h
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "prophage_signal_processor.h"
+
+// A run of 1s in clustered output. Windows are row indices [begin, end);
+// [startCoord, endCoord) is the same region in genomic coordinates, as in BED.
+struct Interval {
+    size_t contig = 0;
+    size_t begin = 0, end = 0;
+    long long startCoord = 0, endCoord = 0;
+    // Fraction of the region's windows the model called before clustering
+    double score = 0;
+};
+
+// Runs of 1s in output within each contig, found by skipping whole words of
+// 0s and 1s. coords gives each row's window start; when it is empty,
+// coordinates are window indices from the start of the contig. A region's
+// end is the start of the next window, or the last window's start plus the
+// contig's last stride at the contig end.
+std::vector<Interval> findIntervals(const BitLabels& output, const BitLabels& input,
+                                    const std::vector<ContigRange>& contigs, const std::vector<long long>& coords);
+
+// Output written per file extension: .bed gives contig/start/end/score
+// regions (tab-separated, bedGraph layout), .psruns the binary run-length
+// form, anything else one label per window.
+enum OutputFormat { OUTPUT_LABELS, OUTPUT_BED, OUTPUT_RUNS };
+OutputFormat outputFormat(const std::string& filename);
+
+// Writes output in the format of filename's extension. Contigs without a
+// name are written as defaultContig.
+void writeOutput(const std::string& filename, const BitLabels& output, const BitLabels& input,
+                 const std::vector<ContigRange>& contigs, const std::vector<long long>& coords,
+                 const std::string& defaultContig);
+
+void writeIntervals(const std::string& filename, const std::vector<Interval>& intervals,
+                    const std::vector<ContigRange>& contigs, const std::string& defaultContig);
+
+// Run-length binary form of a label track (.psruns):
+//
+//   magic "PSPRUNS1", uint64 windows, uint64 contigCount
+//   per contig: uint32 name length, name, uint64 begin, uint64 end,
+//               uint64 runCount, then runCount pairs of LEB128 varints
+//               (0s since the previous run or the contig start, run length)
+//
+// Integers are little-endian as written by the host. A genome with a few
+// dozen prophage regions takes a few hundred bytes.
+void writeRuns(const std::string& filename, const BitLabels& output, const std::vector<ContigRange>& contigs);
+BitLabels readRuns(const std::string& filename, std::vector<ContigRange>* contigs = nullptr);
@@ -0,0 +1,291 @@
+// main.cpp: the command-line client. Everything it runs lives in the
+// library sources; this file only parses arguments and reports results.
+
+#include "prophage_signal_processor.h"
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include "evaluation.h"
+#include "intervals.h"
+#include "profile.h"
+#include "thread_pool.h"
+#include "track_file.h"
+
+int main(int argc, char* argv[]) {
+    // Named options may appear anywhere; everything else is positional
+    std::vector<std::string> args;
+    std::string labelColumn = "label";
+    std::string truthColumn = "reference";
+    std::string contigColumn;
+    std::string coordColumn = "genomic_coord";
+    std::string scoreColumn = "prob_1";
+    std::string profilePath;
+    std::string regionReport;
+    double threshold = 0.5;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--label-col" && i + 1 < argc) labelColumn = argv[++i];
+        else if (arg == "--truth-col" && i + 1 < argc) truthColumn = argv[++i];
+        else if (arg == "--contig-col" && i + 1 < argc) contigColumn = argv[++i];
+        else if (arg == "--coord-col" && i + 1 < argc) coordColumn = argv[++i];
+        else if (arg == "--score-col" && i + 1 < argc) scoreColumn = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc) threshold = std::stod(argv[++i]);
+        else if (arg == "--pin-threads") ThreadPool::setAffinity(true);
+        else if (arg == "--profile" && i + 1 < argc) profilePath = argv[++i];
+        else if (arg == "--region-report" && i + 1 < argc) regionReport = argv[++i];
+        else args.push_back(arg);
+    }
+    argc = static_cast<int>(args.size());
+
+    if (argc >= 2 && (args[1] == "-h" || args[1] == "--help")) {
+        printHelp();
+        return 0;
+    }
+
+    if (argc >= 2 && args[1] == "batch") {
+        return runBatch(args, labelColumn, truthColumn, contigColumn, coordColumn, scoreColumn);
+    }
+    if (argc >= 2 && args[1] == "merge") {
+        return runMerge(args);
+    }
+    if (argc >= 2 && args[1] == "cache-stats") {
+        return runCacheStats(args);
+    }
+    if (argc >= 2 && args[1] == "sweep") {
+        return runSweep(args, labelColumn, truthColumn, contigColumn);
+    }
+    if (argc >= 2 && args[1] == "stream") {
+        return runStream(args, labelColumn, truthColumn, contigColumn);
+    }
+    if (argc >= 2 && args[1] == "bench") {
+        return runBench(args);
+    }
+
+    if (argc < 4) {
+        std::cerr << "Usage: " << args[0] << " <input_file> <output_file> <algorithm> [parameters] [num_threads]\n";
+        std::cerr << "Use -h or --help for more information.\n";
+        return 1;
+    }
+
+    std::string inputFile = args[1];
+    std::string outputFile = args[2];
+    int numThreads = static_cast<int>(ThreadPool::shared().concurrency());
+
+    Pipeline pipeline;
+    size_t next = 0;
+    try {
+        pipeline = parseAlgorithmArguments(args, 3, &next);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    if (next < args.size()) numThreads = std::stoi(args[next]);
+
+    std::optional<RunProfile> profile;
+    if (!profilePath.empty()) profile.emplace(inputFile, pipelineSpec(pipeline), numThreads);
+    auto phase = [&](const char* name) {
+        if (profile) profile->begin(name);
+    };
+    // Counts and metrics go into the profile after the timed phases, so
+    // computing them does not skew the timings
+    auto writeProfile = [&](const BitLabels& input, const BitLabels& output, const BitLabels& trueLabels,
+                            const std::vector<ContigRange>& contigs) {
+        if (!profile) return true;
+        profile->end();
+        auto [flippedOn, flippedOff] = countFlips(input, output);
+        profile->count("windows", static_cast<long long>(output.size()));
+        profile->count("contigs", static_cast<long long>(contigs.size()));
+        profile->count("clusters", countClusters(output, contigs));
+        profile->count("windows_flipped_on", flippedOn);
+        profile->count("windows_flipped_off", flippedOff);
+        if (!trueLabels.empty()) {
+            profile->metrics("before", computeMetrics(trueLabels, input));
+            profile->metrics("after", computeMetrics(trueLabels, output));
+        }
+        try {
+            profile->write(profilePath);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return false;
+        }
+        std::cout << "Profile written to " << profilePath << "\n";
+        return true;
+    };
+
+    // Interval output is named after the input when the rows carry no contig name
+    OutputFormat format = outputFormat(outputFile);
+    std::string defaultContig = std::filesystem::path(inputFile).stem().string();
+    auto write = [&](const BitLabels& output, const BitLabels& input, const std::vector<ContigRange>& contigs,
+                     const std::vector<long long>& coords) {
+        try {
+            writeOutput(outputFile, output, input, contigs, coords, defaultContig);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return false;
+        }
+        if (format == OUTPUT_BED && coords.empty()) {
+            std::cout << "No " << coordColumn << " column; interval coordinates are window indices\n";
+        }
+        std::cout << "Processing complete. Output written to " << outputFile << "\n";
+        return true;
+    };
+
+    // Raw inference output, as CSV or .pstrack, is thresholded and clustered
+    // in one pass, with no processed CSV in between
+    bool scored = readsScores(pipeline[0].name);
+    if (isPredictionInput(inputFile, labelColumn) || (scored && isTrackFile(inputFile))) {
+        BitLabels output, thresholded;
+        try {
+            phase("parse_cluster");
+            auto start = std::chrono::steady_clock::now();
+            bool keepInput = profile || format == OUTPUT_BED;
+            output = clusterPredictions(inputFile, threshold, pipeline, keepInput ? &thresholded : nullptr);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Clustered " << output.size() << " windows from prob_1 in " << elapsed.count() << " s\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+        phase("write");
+        std::vector<ContigRange> contigs = {{"", 0, output.size()}};
+        if (!write(output, thresholded, contigs, {})) return 1;
+        std::cout << "No truth labels available, skipping metrics." << std::endl;
+        return writeProfile(thresholded, output, BitLabels(), contigs) ? 0 : 1;
+    }
+
+    LabelTrack track;
+    try {
+        phase("parse");
+        auto parseStart = std::chrono::steady_clock::now();
+        track = readLabelTrack(inputFile, labelColumn, truthColumn, contigColumn, coordColumn, scored ? scoreColumn : "");
+        std::chrono::duration<double> parseTime = std::chrono::steady_clock::now() - parseStart;
+
+        double megabytes = static_cast<double>(std::filesystem::file_size(inputFile)) / (1024.0 * 1024.0);
+        std::cout << "Parsed " << track.labels.size() << " windows (" << megabytes << " MB) in "
+                  << parseTime.count() << " s, " << megabytes / std::max(parseTime.count(), 1e-9) << " MB/s\n";
+        if (!contigColumn.empty()) std::cout << "Found " << track.contigs.size() << " contigs\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    BitLabels output;
+    try {
+        phase("cluster");
+        output = runPipelineByContig(pipeline, track, numThreads);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    phase("write");
+    if (!write(output, track.labels, track.contigs, track.coords)) return 1;
+
+    phase("metrics");
+    if (track.trueLabels.empty()) {
+        std::cout << "No truth labels available, skipping metrics." << std::endl;
+        return writeProfile(track.labels, output, track.trueLabels, track.contigs) ? 0 : 1;
+    }
+    Evaluation before, after;
+    try {
+        before = evaluate(track.trueLabels, track.labels, track.contigs, track.coords);
+        after = evaluate(track.trueLabels, output, track.contigs, track.coords);
+        if (!regionReport.empty()) writeRegionReport(regionReport, after, track.contigs, defaultContig);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    // Region metrics come first so the last lines stay the window metrics
+    // that run_psp_*.sh read with tail
+    std::cout << "Region metrics before clustering:" << std::endl;
+    printRegionMetrics(before.regions, std::cout);
+    std::cout << "\nRegion metrics after clustering:" << std::endl;
+    printRegionMetrics(after.regions, std::cout);
+    if (track.coords.empty()) std::cout << "No " << coordColumn << " column; boundary errors are in windows" << std::endl;
+    if (!regionReport.empty()) std::cout << "Per-region results written to " << regionReport << std::endl;
+
+    std::cout << "\nMetrics before clustering:" << std::endl;
+    printMetrics(before.windows, std::cout);
+    std::cout << "\nMetrics after clustering:" << std::endl;
+    printMetrics(after.windows, std::cout);
+
+    return writeProfile(track.labels, output, track.trueLabels, track.contigs) ? 0 : 1;
+}
+
+void printHelp() {
+     std::cout << "Usage: prophage_signal_processor <input_file> <output_file> <algorithm> [parameters] [num_threads]\n\n"
+              << "Algorithms:\n"
+              << "  mwa <window_size> <threshold>   : Moving Window Average\n"
+              << "  rle <min_length>                : Run Length Encoding\n"
+              << "  dbscan <eps> <min_pts>          : DBSCAN\n"
+              << "  median <window_size>            : Median Filter\n"
+              << "  ccl <min_size>                  : Connected Component Labeling\n"
+              << "  pmwa <window_size> <threshold>  : Moving Window Average of prob_1\n"
+              << "  hmm <enter> <exit>              : Two-state HMM over prob_1, decoded by Viterbi; enter and exit are the\n"
+              << "                                    per-window probabilities of switching into and out of a prophage\n"
+              << "  pmwa and hmm read prob_1 from raw predictions, a .pstrack or a CSV with a --score-col column.\n\n"
+              << "Lengths in bp:\n"
+              << "  Lengths may carry a bp suffix, e.g. ccl:4000bp:800bp or mwa:7000bp:0.2. Such specs run on runs of\n"
+              << "  positive windows placed by --coord-col, in time proportional to the number of runs; missing\n"
+              << "  windows count as 0s. On evenly spaced windows the output equals the spec in windows.\n\n"
+              << "Pipelines:\n"
+              << "  The algorithm may be given as one spec, e.g. mwa:70:0.2, or as specs joined by |, e.g.\n"
+              << "  'median:5|ccl:40:8', each stage running on the previous one's output. This matches running\n"
+              << "  the stages one after another, without writing the labels in between. pmwa and hmm can only come first.\n"
+              << "  Batch, stream and bench accept pipeline specs wherever they take an algorithm spec.\n\n"
+              << "Raw inference output (SeqID,prediction) is accepted directly: prob_1 is thresholded\n"
+              << "at --threshold and clustered in the same pass, with no process_csv step.\n\n"
+              << "Batch mode:\n"
+              << "  prophage_signal_processor batch <input_dir|manifest> <output_dir> [algorithm_spec ...] [--jobs N] [--threads N]\n"
+              << "                                  [--shard i/N] [--cache dir]\n"
+              << "  Runs each algorithm spec (e.g. mwa:70:0.2 ccl:40:8) on every genome and writes\n"
+              << "  results_table.csv, final_averages.csv and final_pooled.csv (summed counts) to output_dir.\n"
+              << "  With --shard i/N only shard i of a size-balanced split of the inputs runs, and its counts go\n"
+              << "  to output_dir/shard_i_of_N.csv; run every i from 0 to N-1, e.g. as a SLURM array, then merge.\n\n"
+              << "Merge mode:\n"
+              << "  prophage_signal_processor merge <partial_dir> [output_dir]\n"
+              << "  Sums the counts of all N shard files and writes the same tables as an unsharded batch run.\n\n"
+              << "Result cache:\n"
+              << "  --cache <dir> (batch and sweep) keeps each file's counts per algorithm spec, keyed by a hash of\n"
+              << "  the file's contents, the spec, the column options and the binary. Later runs reuse them and\n"
+              << "  parse only files with a missing result. Batch also stores the output labels as .psruns.\n"
+              << "  prophage_signal_processor cache-stats <dir> reports the entries and the hits and misses per run.\n\n"
+              << "Sweep mode:\n"
+              << "  prophage_signal_processor sweep <input_dir|manifest|file> <output_csv> <grid ...> [--threads N] [--cache dir]\n"
+              << "  Grids give each parameter as a value, a list (a,b,c) or a range (lo-hi/step):\n"
+              << "    mwa:10-100/10:0.1-0.9/0.1   rle:2-20   ccl:10-60/5:0-10\n"
+              << "  Writes confusion counts and metrics for every grid point.\n\n"
+              << "Stream mode:\n"
+              << "  prophage_signal_processor stream <input_file|-> <output_file|-> <algorithm> [parameters]\n"
+              << "  Reads rows incrementally (- for stdin/stdout) and writes each label as soon as it is\n"
+              << "  final, holding only a window of state. Metrics are kept as running counts.\n\n"
+              << "Bench mode:\n"
+              << "  prophage_signal_processor bench <output_json|-> [algorithm_spec ...] [--sizes 1e4,1e6] [--threads 1,2,4]\n"
+              << "                                  [--repeat N] [--data data_dir] [--scratch dir] [--seed N]\n"
+              << "  Times process_predictions_csv, readCSV, writeCSV and each algorithm on data_dir/raw_inference_data\n"
+              << "  and on synthetic genomes of each size (default 1e4..1e8 windows), reporting windows/s,\n"
+              << "  bytes/s and peak RSS per thread count.\n\n"
+              << "Output formats, chosen by the output file's extension:\n"
+              << "  .bed                            : One contig/start/end/score line per region, in --coord-col\n"
+              << "                                    coordinates; score is the fraction of windows called before clustering\n"
+              << "  .psruns                         : Run-length binary labels (see intervals.h)\n"
+              << "  anything else                   : One label per window\n\n"
+              << "Options:\n"
+              << "  --label-col <name>              : Column holding predicted labels (default: label)\n"
+              << "  --truth-col <name>              : Column holding true labels (default: reference)\n"
+              << "  --contig-col <name>             : Sequence-id column; clusters never cross a change in it\n"
+              << "                                    (single-file, batch, sweep and stream modes)\n"
+              << "  --score-col <name>              : prob_1 column for pmwa and hmm on CSV input (default: prob_1)\n"
+              << "  --coord-col <name>              : Window start coordinate column for .bed output and boundary errors\n"
+              << "                                    (default: genomic_coord)\n"
+              << "  --region-report <file>          : Write per-truth-region detection, coverage, overlap and boundary\n"
+              << "                                    errors after clustering as CSV\n"
+              << "  --threshold <value>             : prob_1 cut-off for raw predictions (default: 0.5)\n"
+              << "  --pin-threads                   : Pin each pool thread to one of the CPUs the process may use\n"
+              << "  --profile <file>                : Write per-phase wall/CPU time, per-thread busy time, peak RSS,\n"
+              << "                                    cluster and flip counts and metrics as JSON (CSV for a .csv file)\n\n"
+              << "Example:\n"
+              << "  prophage_signal_processor input.csv output.csv mwa 5 0.6 4\n"
+              << "  prophage_signal_processor input.csv output.bed 'median:5|ccl:40:8' 4\n";
+}
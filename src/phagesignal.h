@@ -0,0 +1,423 @@
+// phagesignal.h
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bit_labels.h"
+
+// In-process interface to the clustering algorithms, built as
+// libphagesignal.a / libphagesignal.so (see the README). Inputs and outputs
+// are views of caller-owned memory: the *Into functions below write every
+// output label, never allocate and never start threads, so one output buffer
+// can be reused for every genome and separate genomes can be clustered
+// concurrently from the caller's own threads. The std::vector<int> and
+// BitLabels versions of each algorithm are wrappers over these that only add
+// threads, so there is one implementation of every algorithm.
+//
+// Labels may be bytes (0 or nonzero) in a Span or bit-packed in a BitSpan,
+// on either side; prob_1 scores are a Span of float or double.
+
+// Contiguous values owned by someone else, as std::span in C++20
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(T* data, size_t size) : data_(data), size_(size) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    Span(std::vector<U>& values) : data_(values.data()), size_(values.size()) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<const U*, T*>::value>>
+    Span(const std::vector<U>& values) : data_(values.data()), size_(values.size()) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    Span(const Span<U>& other) : data_(other.data()), size_(other.size()) {}
+
+    T* data() const { return data_; }
+    size_t size() const { return size_; }
+    T& operator[](size_t i) const { return data_[i]; }
+
+    // Label access, reading any nonzero value as 1
+    bool get(size_t i) const { return data_[i] != T(0); }
+    size_t findNextOne(size_t pos) const {
+        while (pos < size_ && data_[pos] == T(0)) ++pos;
+        return pos;
+    }
+    size_t findNextZero(size_t pos) const {
+        while (pos < size_ && data_[pos] != T(0)) ++pos;
+        return pos;
+    }
+
+    // Labels [pos, pos + 64) as bits, with 0s outside the span
+    uint64_t wordAt(long long pos) const {
+        long long n = static_cast<long long>(size_);
+        uint64_t word = 0;
+        if (pos >= 0 && pos + 64 <= n) {
+            const T* p = data_ + pos;
+            for (int k = 0; k < 64; ++k) word |= static_cast<uint64_t>(p[k] != T(0)) << k;
+            return word;
+        }
+        for (int k = 0; k < 64; ++k) {
+            long long i = pos + k;
+            if (i >= 0 && i < n && data_[i] != T(0)) word |= uint64_t(1) << k;
+        }
+        return word;
+    }
+
+    void clear() const { std::fill(data_, data_ + size_, T(0)); }
+    void set(size_t i) const { data_[i] = T(1); }
+    void fill(size_t begin, size_t end) const { std::fill(data_ + begin, data_ + end, T(1)); }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Bit-packed labels owned by someone else, in the BitLabels layout: window i
+// is bit i % 64 of word i / 64. Bits past size() in the last word must be 0
+// on input and are written as 0 on output.
+template <typename Word>
+class BitSpan {
+public:
+    BitSpan() = default;
+    BitSpan(Word* words, size_t size) : words_(words), size_(size) {}
+    template <typename W, typename = std::enable_if_t<std::is_convertible<W*, Word*>::value>>
+    BitSpan(const BitSpan<W>& other) : words_(other.words()), size_(other.size()) {}
+
+    Word* words() const { return words_; }
+    size_t size() const { return size_; }
+    size_t wordCount() const { return (size_ + 63) / 64; }
+    bool operator[](size_t i) const { return get(i); }
+
+    bool get(size_t i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+    size_t findNextOne(size_t pos) const { return findNext(pos, 0); }
+    size_t findNextZero(size_t pos) const { return findNext(pos, ~uint64_t(0)); }
+
+    // Labels [pos, pos + 64) as bits, with 0s outside the span
+    uint64_t wordAt(long long pos) const {
+        if (pos <= -64 || pos >= static_cast<long long>(size_)) return 0;
+        if (pos < 0) return wordAt(0) << -pos;
+        size_t w = static_cast<size_t>(pos) >> 6, shift = static_cast<size_t>(pos) & 63;
+        uint64_t word = words_[w] >> shift;
+        if (shift && w + 1 < wordCount()) word |= words_[w + 1] << (64 - shift);
+        return word;
+    }
+
+    void clear() const { std::fill(words_, words_ + wordCount(), uint64_t(0)); }
+    void set(size_t i) const { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+    void fill(size_t begin, size_t end) const {
+        if (begin >= end) return;
+        size_t first = begin >> 6, last = (end - 1) >> 6;
+        uint64_t head = ~uint64_t(0) << (begin & 63);
+        uint64_t tail = ~uint64_t(0) >> (63 - ((end - 1) & 63));
+        if (first == last) {
+            words_[first] |= head & tail;
+            return;
+        }
+        words_[first] |= head;
+        for (size_t w = first + 1; w < last; ++w) words_[w] = ~uint64_t(0);
+        words_[last] |= tail;
+    }
+
+private:
+    size_t findNext(size_t pos, uint64_t flip) const {
+        if (pos >= size_) return size_;
+        size_t w = pos >> 6, words = wordCount();
+        uint64_t word = (words_[w] ^ flip) & (~uint64_t(0) << (pos & 63));
+        while (true) {
+            if (word) {
+                size_t found = (w << 6) + static_cast<size_t>(__builtin_ctzll(word));
+                return found < size_ ? found : size_;
+            }
+            if (++w >= words) return size_;
+            word = words_[w] ^ flip;
+        }
+    }
+
+    Word* words_ = nullptr;
+    size_t size_ = 0;
+};
+
+inline BitSpan<uint64_t> bitSpan(BitLabels& labels) { return {labels.words().data(), labels.size()}; }
+inline BitSpan<const uint64_t> bitSpan(const BitLabels& labels) { return {labels.words().data(), labels.size()}; }
+
+enum AlgorithmType {
+    ALGORITHM_MWA, ALGORITHM_PMWA, ALGORITHM_RLE, ALGORITHM_DBSCAN, ALGORITHM_MEDIAN, ALGORITHM_CCL, ALGORITHM_HMM
+};
+
+// An algorithm with typed parameters. Fields the algorithm does not use are 0.
+struct Algorithm {
+    AlgorithmType type = ALGORITHM_MWA;
+    int windowSize = 0;    // mwa, pmwa, median
+    double threshold = 0;  // mwa, pmwa: mean a window must reach
+    int minSize = 0;       // rle: minimum run length; ccl: minimum component size
+    int gapTolerance = 0;  // ccl
+    int eps = 0, minPts = 0;  // dbscan
+    double enterProbability = 0, exitProbability = 0;  // hmm: per-window host <-> prophage transitions
+    // Lengths (window sizes, minimum sizes, gaps, eps) are in bp rather than
+    // windows. Only the sparse track (sparse_track.h) runs these.
+    bool basePairs = false;
+
+    static Algorithm mwa(int windowSize, double threshold) { return {ALGORITHM_MWA, windowSize, threshold}; }
+    static Algorithm pmwa(int windowSize, double threshold) { return {ALGORITHM_PMWA, windowSize, threshold}; }
+    static Algorithm rle(int minLength) { return {ALGORITHM_RLE, 0, 0, minLength}; }
+    static Algorithm dbscan(int eps, int minPts) { return {ALGORITHM_DBSCAN, 0, 0, 0, 0, eps, minPts}; }
+    static Algorithm median(int windowSize) { return {ALGORITHM_MEDIAN, windowSize}; }
+    static Algorithm ccl(int minSize, int gapTolerance) { return {ALGORITHM_CCL, 0, 0, minSize, gapTolerance}; }
+    static Algorithm hmm(double enter, double exit) { return {ALGORITHM_HMM, 0, 0, 0, 0, 0, 0, enter, exit}; }
+
+    // pmwa and hmm read prob_1 scores rather than labels
+    bool readsScores() const { return type == ALGORITHM_PMWA || type == ALGORITHM_HMM; }
+};
+
+// Parses a command-line spec such as "ccl:40:8"; throws std::invalid_argument.
+Algorithm parseAlgorithm(const std::string& spec);
+
+// Smallest window sum whose average passes threshold, i.e. the integer
+// form of sum / windowSize >= threshold. windowSize + 1 if none does.
+int minimumWindowSum(int windowSize, double threshold);
+
+template <typename Input, typename Output>
+void checkSizes(const Input& input, const Output& output) {
+    if (input.size() != output.size()) {
+        throw std::invalid_argument("output holds " + std::to_string(output.size()) + " labels, input has " +
+                                    std::to_string(input.size()));
+    }
+}
+
+// The window count behind mwa and median: output[c] = 1 for c in
+// [validBegin, validEnd) when the window [c - lowOffset, c - lowOffset + windowSize),
+// clipped to the input, holds at least minCount 1s.
+struct WindowCount {
+    long long lowOffset = 0;
+    int windowSize = 0;
+    long long minCount = 0;
+    long long validBegin = 0, validEnd = 0;
+};
+
+inline WindowCount mwaWindowCount(size_t size, int windowSize, double threshold) {
+    if (windowSize < 1) {
+        throw std::invalid_argument("Moving Window Average requires a positive window size.");
+    }
+    // The window ending at i is written to i - windowSize / 2
+    long long half = windowSize / 2;
+    return {windowSize - 1 - half, windowSize, minimumWindowSum(windowSize, threshold), windowSize - 1 - half,
+            static_cast<long long>(size) - half};
+}
+
+inline WindowCount medianWindowCount(size_t size, int windowSize) {
+    if (windowSize < 1) {
+        throw std::invalid_argument("Median Filter requires a positive window size.");
+    }
+    // Zero-padded window centred on c; the median is 1 with windowSize - windowSize / 2 ones
+    long long half = windowSize / 2;
+    return {half, windowSize, windowSize - half, 0, static_cast<long long>(size)};
+}
+
+// Sets the passing outputs among c in [from, to) and leaves the rest of output
+// untouched, so threads may fill disjoint ranges of one zeroed buffer (whole
+// words of a BitSpan). Outputs go 64 at a time: the labels entering and
+// leaving the window over a block are two words, and their popcounts bound
+// the count across the block, so blocks that are all 0 or all 1 cost a few
+// word operations; the rest step the count bit by bit without bounds checks.
+// The count starts afresh at from, so the result does not depend on how the
+// ranges are cut.
+template <typename Input, typename Output>
+void windowCountRange(Input input, Output output, const WindowCount& window, long long from, long long to) {
+    from = std::max(from, window.validBegin);
+    to = std::min(to, window.validEnd);
+    if (from >= to) return;
+    auto low = [](long long length) { return length >= 64 ? ~uint64_t(0) : (uint64_t(1) << length) - 1; };
+    auto ones = [](uint64_t word) { return static_cast<long long>(__builtin_popcountll(word)); };
+
+    // Window of from: [from - lowOffset, from - lowOffset + windowSize)
+    long long count = 0;
+    long long first = from - window.lowOffset, last = first + window.windowSize;
+    for (long long i = first; i < last; i += 64) count += ones(input.wordAt(i) & low(last - i));
+
+    for (long long block = from; block < to; block += 64) {
+        long long length = std::min<long long>(64, to - block);
+        // Step k moves the window of block + k to that of block + k + 1
+        uint64_t entering = input.wordAt(block - window.lowOffset + window.windowSize) & low(length);
+        uint64_t leaving = input.wordAt(block - window.lowOffset) & low(length);
+        if (count + ones(entering) < window.minCount) {
+            // No window in the block can reach minCount
+        } else if (count - ones(leaving) >= window.minCount) {
+            output.fill(static_cast<size_t>(block), static_cast<size_t>(block + length));
+        } else {
+            uint64_t passing = 0;
+            long long c = count;
+            for (long long k = 0; k < length; ++k) {
+                passing |= static_cast<uint64_t>(c >= window.minCount) << k;
+                c += static_cast<long long>((entering >> k) & 1) - static_cast<long long>((leaving >> k) & 1);
+            }
+            for (; passing; passing &= passing - 1) {
+                output.set(static_cast<size_t>(block + __builtin_ctzll(passing)));
+            }
+        }
+        count += ones(entering) - ones(leaving);
+    }
+}
+
+template <typename Input, typename Output>
+void windowCountInto(Input input, Output output, const WindowCount& window) {
+    checkSizes(input, output);
+    output.clear();
+    windowCountRange(input, output, window, window.validBegin, window.validEnd);
+}
+
+template <typename Input, typename Output>
+void movingWindowAverageInto(Input input, Output output, int windowSize, double threshold) {
+    windowCountInto(input, output, mwaWindowCount(input.size(), windowSize, threshold));
+}
+
+template <typename Input, typename Output>
+void medianFilterInto(Input input, Output output, int windowSize) {
+    windowCountInto(input, output, medianWindowCount(input.size(), windowSize));
+}
+
+// Moving window average of scores: the window ending at i is written to
+// i - windowSize / 2 when its mean reaches threshold. The running sum is
+// rebuilt every windowSize scores, exactly as the streaming pmwa does, so the
+// two agree bit for bit.
+template <typename Scores, typename Output>
+void probabilityWindowAverageInto(Scores scores, Output output, int windowSize, double threshold) {
+    if (windowSize < 1) {
+        throw std::invalid_argument("Probability-weighted MWA requires a positive window size.");
+    }
+    checkSizes(scores, output);
+    output.clear();
+    size_t n = scores.size(), window = static_cast<size_t>(windowSize), half = window / 2;
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += static_cast<double>(scores[i]) - (i >= window ? static_cast<double>(scores[i - window]) : 0.0);
+        if ((i + 1) % window == 0) {
+            sum = 0;
+            for (size_t j = i + 1 - window; j <= i; ++j) sum += static_cast<double>(scores[j]);
+        }
+        if (i + 1 >= window && sum / windowSize >= threshold) output.set(i - half);
+    }
+}
+
+template <typename Scores, typename Output>
+void thresholdInto(Scores scores, Output output, double threshold) {
+    checkSizes(scores, output);
+    output.clear();
+    for (size_t i = 0; i < scores.size(); ++i) {
+        if (static_cast<double>(scores[i]) >= threshold) output.set(i);
+    }
+}
+
+template <typename Input, typename Output>
+void runLengthEncodingInto(Input input, Output output, int minLength) {
+    checkSizes(input, output);
+    output.clear();
+    size_t n = input.size();
+    for (size_t start = input.findNextOne(0); start < n;) {
+        size_t end = input.findNextZero(start);
+        if (static_cast<long long>(end - start) >= minLength) output.fill(start, end);
+        start = input.findNextOne(end);
+    }
+}
+
+// Runs separated by at most gapTolerance 0s form one component, which extends
+// gapTolerance windows past its last run and is kept when at least minSize long.
+template <typename Input, typename Output>
+void connectedComponentLabelingInto(Input input, Output output, int minSize, int gapTolerance) {
+    checkSizes(input, output);
+    output.clear();
+    size_t n = input.size();
+    size_t gap = static_cast<size_t>(gapTolerance > 0 ? gapTolerance : 0);
+    size_t start = input.findNextOne(0);
+    while (start < n) {
+        size_t end = input.findNextZero(start), next;
+        while ((next = input.findNextOne(end)) < n && next - end <= gap) end = input.findNextZero(next);
+        size_t componentEnd = std::min(end + gap, n);
+        if (static_cast<long long>(componentEnd - start) >= minSize) output.fill(start, componentEnd);
+        start = next;
+    }
+}
+
+// A chain of 1s whose consecutive members are at most eps apart is kept if any
+// member has at least minPts 1s within eps. The count comes from two cursors
+// stepping over the 1s, so the cost is linear in the runs, not the windows.
+template <typename Input, typename Output>
+void dbscanInto(Input input, Output output, int eps, int minPts) {
+    checkSizes(input, output);
+    output.clear();
+    size_t n = input.size();
+    auto copyOnes = [&](size_t first, size_t last) {
+        for (size_t r = first; r <= last && r < n;) {
+            size_t end = std::min(input.findNextZero(r), last + 1);
+            output.fill(r, end);
+            r = input.findNextOne(end);
+        }
+    };
+    if (eps < 0) {
+        // Every 1 is its own chain and no window holds any 1s
+        if (minPts <= 0 && n > 0) copyOnes(0, n - 1);
+        return;
+    }
+
+    long long reach = eps;
+    size_t lo = input.findNextOne(0), hi = lo;
+    long long count = 0;
+    size_t first = n, last = 0;
+    bool core = false;
+    for (size_t i = lo; i < n; i = input.findNextOne(i + 1)) {
+        if (first < n && static_cast<long long>(i - last) > reach) {
+            if (core) copyOnes(first, last);
+            first = n;
+        }
+        if (first == n) {
+            first = i;
+            core = false;
+        }
+        last = i;
+        while (hi < n && static_cast<long long>(hi) <= static_cast<long long>(i) + reach) {
+            ++count;
+            hi = input.findNextOne(hi + 1);
+        }
+        while (static_cast<long long>(lo) < static_cast<long long>(i) - reach) {
+            --count;
+            lo = input.findNextOne(lo + 1);
+        }
+        core = core || count >= minPts;
+    }
+    if (first < n && core) copyOnes(first, last);
+}
+
+// Runs algorithm from input into output. pmwa reads input as scores; the
+// other algorithms read it as labels. hmm keeps checkpoints between its two
+// passes, so it is only available as viterbiSegment.
+template <typename Input, typename Output>
+void clusterInto(const Algorithm& algorithm, Input input, Output output) {
+    if (algorithm.basePairs) {
+        throw std::invalid_argument("Lengths in bp need window coordinates; run them with clusterSparse.");
+    }
+    switch (algorithm.type) {
+        case ALGORITHM_MWA:
+            movingWindowAverageInto(input, output, algorithm.windowSize, algorithm.threshold);
+            break;
+        case ALGORITHM_PMWA:
+            probabilityWindowAverageInto(input, output, algorithm.windowSize, algorithm.threshold);
+            break;
+        case ALGORITHM_RLE:
+            runLengthEncodingInto(input, output, algorithm.minSize);
+            break;
+        case ALGORITHM_DBSCAN:
+            dbscanInto(input, output, algorithm.eps, algorithm.minPts);
+            break;
+        case ALGORITHM_MEDIAN:
+            medianFilterInto(input, output, algorithm.windowSize);
+            break;
+        case ALGORITHM_CCL:
+            connectedComponentLabelingInto(input, output, algorithm.minSize, algorithm.gapTolerance);
+            break;
+        case ALGORITHM_HMM:
+            throw std::invalid_argument("hmm allocates its traceback checkpoints; call viterbiSegment instead.");
+    }
+}
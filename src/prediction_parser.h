@@ -0,0 +1,59 @@
+// prediction_parser.h
+
+#pragma once
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// True if the file starts with the "SeqID,prediction" header of raw inference output
+inline bool is_prediction_file(const std::string& filename) {
+    std::ifstream in(filename);
+    std::string header;
+    std::getline(in, header);
+    return header.rfind("SeqID,prediction", 0) == 0;
+}
+
+// Calls fn(seq_id, prob0, prob1) for every row of raw inference output in
+// the form "SeqID,prediction" / "1,[0.91, 0.09]". The header line is skipped
+// and blank lines are ignored. Throws std::runtime_error on malformed rows.
+template <typename Fn>
+void for_each_prediction(const char* begin, const char* end,
+                         const std::string& filename, Fn&& fn) {
+    const char* p = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    p = p ? p + 1 : end;
+
+    size_t line_number = 1;
+    while (p < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!line_end) line_end = end;
+        ++line_number;
+
+        const char* q = line_end;
+        if (q > p && q[-1] == '\r') --q;
+        if (q > p) {
+            auto fail = [&]() {
+                throw std::runtime_error(filename + ":" + std::to_string(line_number) + ": malformed prediction");
+            };
+
+            const char* comma = static_cast<const char*>(std::memchr(p, ',', q - p));
+            if (!comma || comma + 1 >= q || comma[1] != '[') fail();
+            std::string_view seq_id(p, comma - p);
+
+            double prob0 = 0.0, prob1 = 0.0;
+            const char* c = comma + 2;
+            auto r0 = std::from_chars(c, q, prob0);
+            if (r0.ec != std::errc() || r0.ptr >= q || *r0.ptr != ',') fail();
+            c = r0.ptr + 1;
+            while (c < q && *c == ' ') ++c;
+            auto r1 = std::from_chars(c, q, prob1);
+            if (r1.ec != std::errc() || r1.ptr >= q || *r1.ptr != ']') fail();
+
+            fn(seq_id, prob0, prob1);
+        }
+        p = line_end + 1;
+    }
+}
@@ -0,0 +1,62 @@
+// prediction_writer.h
+
+#pragma once
+
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include "mapped_file.h"
+#include "prediction_parser.h"
+
+// Output is assembled in memory and handed to the stream in blocks of this size
+inline constexpr size_t OUTPUT_BLOCK_SIZE = 1 << 20;
+
+// Appends a double formatted like the default ostream (%g, 6 significant digits)
+inline void append_double(std::string& out, double value) {
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+    out.append(buf, result.ptr);
+}
+
+// Function to process CSV file with prediction data
+inline void process_predictions_csv(const std::string& input_filename, 
+                           const std::string& output_filename,
+                           double threshold = 0.5) {
+    MappedFile inFile(input_filename);
+    std::ofstream outFile(output_filename, std::ios::binary);
+    
+    if (!outFile.is_open()) {
+        throw std::runtime_error("Could not open output file: " + output_filename);
+    }
+    
+    // Write header for output CSV
+    std::string buffer = "Seq_ID,prob_0,prob_1,predicted_label\n";
+    buffer.reserve(OUTPUT_BLOCK_SIZE + 256);
+    
+    // Process each line
+    for_each_prediction(inFile.data(), inFile.end(), input_filename,
+                        [&](std::string_view seqID, double prob0, double prob1) {
+        // Determine predicted label
+        int predicted_label = (prob1 >= threshold) ? 1 : 0;
+
+        buffer.append(seqID);
+        buffer += ',';
+        append_double(buffer, prob0);
+        buffer += ',';
+        append_double(buffer, prob1);
+        buffer += ',';
+        buffer += static_cast<char>('0' + predicted_label);
+        buffer += '\n';
+
+        if (buffer.size() >= OUTPUT_BLOCK_SIZE) {
+            outFile.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    });
+
+    outFile.write(buffer.data(), buffer.size());
+    if (!outFile) {
+        throw std::runtime_error("Could not write output file: " + output_filename);
+    }
+}
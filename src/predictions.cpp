@@ -0,0 +1,60 @@
+// predictions.cpp
+
+#include "prophage_signal_processor.h"
+#include "mapped_file.h"
+#include "prediction_parser.h"
+#include "stream_filter.h"
+#include "thread_pool.h"
+#include "track_file.h"
+
+bool isPredictionInput(const std::string& filename, const std::string& labelColumn) {
+    if (!isTrackFile(filename)) return is_prediction_file(filename);
+    // process_csv --binary keeps raw inference output as prob_1 and predicted_label
+    try {
+        TrackFile track(filename);
+        return track.find("prob_1") && !track.find(labelColumn);
+    } catch (const std::exception&) {
+        // Unreadable tracks are reported by the label reader
+        return false;
+    }
+}
+
+BitLabels clusterPredictions(const std::string& filename, double threshold, const Pipeline& pipeline,
+                             BitLabels* thresholded) {
+    // hmm needs every score for its traceback, so they are collected and the
+    // pipeline runs in memory; the other algorithms stream row by row
+    bool collect = pipeline[0].name == "hmm";
+    std::vector<float> scores;
+    BitLabels output;
+    std::unique_ptr<StreamFilter> filter;
+    if (!collect) filter = makeStreamFilter(pipeline, [&](bool label) { output.push_back(label); });
+    auto push = [&](double probability) {
+        if (thresholded) thresholded->push_back(probability >= threshold);
+        if (collect) scores.push_back(static_cast<float>(probability));
+        else filter->pushProbability(probability, threshold);
+    };
+
+    if (isTrackFile(filename)) {
+        TrackFile track(filename);
+        output.reserve(track.rows());
+        for (float probability : track.floats("prob_1")) push(probability);
+    } else {
+        if (!is_prediction_file(filename)) {
+            throw std::invalid_argument(pipeline[0].name + " needs prob_1 scores: raw inference output, a .pstrack or a CSV with a prob_1 column.");
+        }
+        // Each row is parsed, thresholded and clustered while its line is in
+        // cache; only the filter's window of state is kept between rows
+        MappedFile file(filename);
+        for_each_prediction(file.data(), file.end(), filename, [&](std::string_view, double, double prob1) {
+            push(prob1);
+        });
+    }
+    if (collect) {
+        std::vector<ContigRange> contigs = {{"", 0, scores.size()}};
+        int numThreads = static_cast<int>(ThreadPool::shared().concurrency());
+        output = runScoresByContig(pipeline[0], scores, contigs, numThreads);
+        return runPipelineByContig(Pipeline(pipeline.begin() + 1, pipeline.end()), output, contigs, numThreads);
+    }
+    filter->finish();
+    return output;
+}
@@ -1,122 +1,237 @@
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <mutex>
+#include <thread>
+#include "mapped_file.h"
+#include "prediction_parser.h"
+#include "prediction_writer.h"
+#include "track_file.h"
 namespace fs = std::filesystem;
-// Function to process CSV file with prediction data
-void process_predictions_csv(const std::string& input_filename, 
-                           const std::string& output_filename,
-                           double threshold = 0.5) {
-    std::ifstream inFile(input_filename);
-    std::ofstream outFile(output_filename);
-    
-    if (!inFile.is_open()) {
-        throw std::runtime_error("Could not open input file: " + input_filename);
+
+// Writes the same columns as process_predictions_csv to a binary track:
+// Seq_ID delta-encoded, probabilities as float32 (or uint16 when quantize
+// is set) and predicted_label bit-packed.
+void process_predictions_binary(const std::string& input_filename,
+                                const std::string& output_filename,
+                                double threshold = 0.5, bool quantize = false) {
+    MappedFile inFile(input_filename);
+    std::vector<long long> seq_ids;
+    std::vector<float> prob0s, prob1s;
+    BitLabels predicted;
+
+    for_each_prediction(inFile.data(), inFile.end(), input_filename,
+                        [&](std::string_view seqID, double prob0, double prob1) {
+        long long id = 0;
+        auto result = std::from_chars(seqID.data(), seqID.data() + seqID.size(), id);
+        if (result.ec != std::errc() || result.ptr != seqID.data() + seqID.size()) {
+            throw std::runtime_error("Seq_ID must be numeric for binary output: " + std::string(seqID));
+        }
+        seq_ids.push_back(id);
+        prob0s.push_back(static_cast<float>(prob0));
+        prob1s.push_back(static_cast<float>(prob1));
+        predicted.push_back(prob1 >= threshold);
+    });
+
+    TrackWriter writer(seq_ids.size());
+    writer.addIntegers("Seq_ID", seq_ids);
+    writer.addFloats("prob_0", prob0s, quantize);
+    writer.addFloats("prob_1", prob1s, quantize);
+    writer.addBits("predicted_label", predicted);
+    writer.write(output_filename);
+}
+
+// Converts a numeric CSV such as genomic_coord,label,phaster,reference to a
+// binary track. Columns holding only 0/1 are bit-packed, other integer
+// columns delta-encoded, and the rest stored as floats.
+void convert_csv_binary(const std::string& input_filename,
+                        const std::string& output_filename, bool quantize = false) {
+    MappedFile inFile(input_filename);
+    const char* p = inFile.data();
+    const char* end = inFile.end();
+
+    std::vector<std::string> names;
+    const char* header_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (!header_end) header_end = end;
+    std::string header(p, header_end);
+    if (!header.empty() && header.back() == '\r') header.pop_back();
+    for (size_t start = 0, comma; start <= header.size(); start = comma + 1) {
+        comma = header.find(',', start);
+        if (comma == std::string::npos) comma = header.size();
+        names.push_back(header.substr(start, comma - start));
     }
-    
-    if (!outFile.is_open()) {
-        throw std::runtime_error("Could not open output file: " + output_filename);
+    p = (header_end < end) ? header_end + 1 : end;
+
+    std::vector<std::vector<double>> columns(names.size());
+    size_t line_number = 1;
+    while (p < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!line_end) line_end = end;
+        ++line_number;
+        const char* q = line_end;
+        if (q > p && q[-1] == '\r') --q;
+        if (q > p) {
+            const char* field = p;
+            for (size_t c = 0; c < names.size(); ++c) {
+                double value = 0.0;
+                auto result = std::from_chars(field, q, value);
+                bool last = (c + 1 == names.size());
+                if (result.ec != std::errc() || (last ? result.ptr != q : (result.ptr == q || *result.ptr != ','))) {
+                    throw std::runtime_error(input_filename + ":" + std::to_string(line_number) + ": invalid number in column " + names[c]);
+                }
+                columns[c].push_back(value);
+                field = result.ptr + 1;
+            }
+        }
+        p = line_end + 1;
     }
-    
-    // Write header for output CSV
-    outFile << "Seq_ID,prob_0,prob_1,predicted_label" << std::endl;
-    
-    std::string line;
-    // Skip header line
-    std::getline(inFile, line);
-    
-    // Process each line
-    while (std::getline(inFile, line)) {
-        std::istringstream ss(line);
-        std::string seqID, predictions;
-        
-        // Parse the line
-        if (std::getline(ss, seqID, ',') && std::getline(ss, predictions)) {
-            // Remove brackets from predictions
-            predictions = predictions.substr(1, predictions.length() - 2);
-            
-            // Parse the two probability values
-            std::istringstream pred_ss(predictions);
-            std::string prob0_str, prob1_str;
-            
-            // Get first probability
-            std::getline(pred_ss, prob0_str, ',');
-            // Get second probability and remove leading space
-            std::getline(pred_ss, prob1_str);
-            while (prob1_str[0] == ' ') {
-                prob1_str = prob1_str.substr(1);
+
+    size_t rows = columns.empty() ? 0 : columns[0].size();
+    TrackWriter writer(rows);
+    for (size_t c = 0; c < names.size(); ++c) {
+        const auto& values = columns[c];
+        bool integral = std::all_of(values.begin(), values.end(), [](double v) { return v == static_cast<long long>(v); });
+        bool binary = std::all_of(values.begin(), values.end(), [](double v) { return v == 0.0 || v == 1.0; });
+        if (binary) {
+            BitLabels bits(rows);
+            for (size_t i = 0; i < rows; ++i) if (values[i] == 1.0) bits.set(i);
+            writer.addBits(names[c], bits);
+        } else if (integral) {
+            writer.addIntegers(names[c], std::vector<long long>(values.begin(), values.end()));
+        } else {
+            writer.addFloats(names[c], std::vector<float>(values.begin(), values.end()), quantize);
+        }
+    }
+    writer.write(output_filename);
+}
+
+// Conversion settings shared by every file of a run
+struct convert_options {
+    double threshold = 0.5;
+    bool binary = false;
+    bool quantize = false;
+};
+
+// Output path for input_file: same name in output_dir, with a .pstrack
+// extension in binary mode
+static std::string output_path(const fs::path& input_file, const std::string& output_dir, const convert_options& options) {
+    fs::path name = input_file.filename();
+    if (options.binary) name.replace_extension(".pstrack");
+    return (fs::path(output_dir) / name).string();
+}
+
+// Converts one file. In binary mode raw inference output (a SeqID,prediction
+// header) becomes a prediction track and anything else a numeric track.
+void convert_file(const std::string& input_file, const std::string& output_file, const convert_options& options) {
+    if (!options.binary) {
+        process_predictions_csv(input_file, output_file, options.threshold);
+        return;
+    }
+    if (is_prediction_file(input_file)) {
+        process_predictions_binary(input_file, output_file, options.threshold, options.quantize);
+    } else {
+        convert_csv_binary(input_file, output_file, options.quantize);
+    }
+}
+
+// Converts every CSV file in input_dir, with num_threads workers pulling files
+// from a shared queue. Returns the number of files that failed.
+int process_directory(const std::string& input_dir, const std::string& output_dir,
+                      const convert_options& options, int num_threads) {
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(input_dir)) {
+        if (entry.path().extension() == ".csv") files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    std::atomic<size_t> next_file(0);
+    std::atomic<int> failures(0);
+    std::mutex log_mutex;
+
+    auto worker = [&]() {
+        for (size_t i = next_file++; i < files.size(); i = next_file++) {
+            std::string input_file = files[i].string();
+            std::string output_file = output_path(files[i], output_dir, options);
+            try {
+                {
+                    std::lock_guard<std::mutex> lock(log_mutex);
+                    std::cout << "Processing: " << input_file << "\n";
+                }
+                convert_file(input_file, output_file, options);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cerr << "Error processing file " << input_file << ": " << e.what() << "\n";
+                std::cerr << "Continuing with next file..." << "\n";
+                failures++;
             }
-            
-            // Convert strings to doubles
-            double prob0 = std::stod(prob0_str);
-            double prob1 = std::stod(prob1_str);
-            
-            // Determine predicted label
-            int predicted_label = (prob1 >= threshold) ? 1 : 0;
-            
-            // Write to output file
-            outFile << seqID << ","
-                   << prob0 << ","
-                   << prob1 << ","
-                   << predicted_label << std::endl;
         }
+    };
+
+    num_threads = std::max(1, std::min(num_threads, static_cast<int>(files.size())));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(worker);
     }
-    
-    inFile.close();
-    outFile.close();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return failures;
 }
 
 int main(int argc, char* argv[]) {
+    // Named options may appear anywhere; everything else is positional
+    std::vector<std::string> args;
+    std::string output_dir = "../data/processed_data/";
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    convert_options options;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "-o" || arg == "--output-dir") && i + 1 < argc) output_dir = argv[++i];
+        else if (arg == "-b" || arg == "--binary") options.binary = true;
+        else if (arg == "--quantize") options.quantize = true;
+        else if ((arg == "-j" || arg == "--threads") && i + 1 < argc) num_threads = std::atoi(argv[++i]);
+        else args.push_back(arg);
+    }
+
     // Check if input path is provided
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input_path> [threshold]" << std::endl;
+    if (args.size() < 2) {
+        std::cerr << "Usage: " << args[0] << " <input_path> [threshold] [-o output_dir] [-j num_threads] [--binary [--quantize]]" << std::endl;
         std::cerr << "input_path can be a single file or directory" << std::endl;
-        std::cerr << "Example: " << argv[0] << " ../data/raw_inference_data 0.5" << std::endl;
+        std::cerr << "output_dir defaults to ../data/processed_data/, num_threads to the core count" << std::endl;
+        std::cerr << "--binary writes .pstrack columnar files; --quantize stores probabilities as uint16" << std::endl;
+        std::cerr << "Example: " << args[0] << " ../data/raw_inference_data 0.5 -o ../data/processed_data -j 8" << std::endl;
         return 1;
     }
 
-    std::string input_path = argv[1];
+    std::string input_path = args[1];
     
     // Get threshold from command line if provided
-    double threshold = 0.5;
-    if (argc >= 3) {
+    if (args.size() >= 3) {
         try {
-            threshold = std::stod(argv[2]);
+            options.threshold = std::stod(args[2]);
         } catch (const std::exception& e) {
             std::cerr << "Error: Invalid threshold value. Using default (0.5)" << std::endl;
         }
     }
 
     try {
+        fs::create_directories(output_dir);
         if (fs::is_directory(input_path)) {
-        // Process all CSV files in directory
-        for (const auto& entry : fs::directory_iterator(input_path)) {
-            if (entry.path().extension() == ".csv") {
-                std::string input_file = entry.path().string();
-                std::string base_filename = entry.path().filename().string();
-                std::string output_file = "../data/processed_data/" + base_filename;
-                
-                try {
-                    std::cout << "Processing: " << input_file << std::endl;
-                    process_predictions_csv(input_file, output_file, threshold);
-                } catch (const std::exception& e) {
-                    std::cerr << "Error processing file " << input_file << ": " << e.what() << std::endl;
-                    std::cerr << "Continuing with next file..." << std::endl;
-                    continue;  // Skip to next file instead of stopping
-                }
-            }
-        }
-        std::cout << "Processing completed. Check error messages above for any skipped files." << std::endl;   
+            // Process all CSV files in directory
+            int failures = process_directory(input_path, output_dir, options, num_threads);
+            std::cout << "Processing completed. Check error messages above for any skipped files." << std::endl;   
+            if (failures > 0) return 1;
         } else {
             // Process single file
-            size_t last_slash = input_path.find_last_of("/\\");
-            std::string base_filename = (last_slash != std::string::npos) ? 
-                input_path.substr(last_slash + 1) : input_path;
-            std::string output_file = "../data/processed_data/" + base_filename;
+            std::string output_file = output_path(input_path, output_dir, options);
             
-            process_predictions_csv(input_path, output_file, threshold);
+            convert_file(input_path, output_file, options);
             std::cout << "File processed successfully!" << std::endl;
             std::cout << "Output written to: " << output_file << std::endl;
         }
@@ -0,0 +1,201 @@
+// profile.cpp
+
+#include "profile.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/resource.h>
+#include "thread_pool.h"
+
+long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::stol(line.substr(6));
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+bool resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return static_cast<bool>(clearRefs);
+}
+
+long long countClusters(const BitLabels& labels, const std::vector<ContigRange>& contigs) {
+    long long clusters = 0;
+    for (const auto& contig : contigs) {
+        size_t pos = contig.begin;
+        while (true) {
+            size_t one = labels.findNextOne(pos);
+            if (one >= contig.end) break;
+            ++clusters;
+            pos = labels.findNextZero(one);
+        }
+    }
+    return clusters;
+}
+
+std::pair<long long, long long> countFlips(const BitLabels& input, const BitLabels& output) {
+    long long on = 0, off = 0;
+    const auto& in = input.words();
+    const auto& out = output.words();
+    for (size_t w = 0; w < std::min(in.size(), out.size()); ++w) {
+        on += BitLabels::popcount(out[w] & ~in[w]);
+        off += BitLabels::popcount(in[w] & ~out[w]);
+    }
+    return {on, off};
+}
+
+static double clockSeconds(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) return 0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+RunProfile::RunProfile(std::string input, std::string algorithm, int threads)
+    : input_(std::move(input)), algorithm_(std::move(algorithm)), threads_(threads) {}
+
+RunProfile::Snapshot RunProfile::snapshot() {
+    Snapshot s;
+    s.wall = std::chrono::steady_clock::now();
+    s.processCpu = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    s.threadCpu.push_back(clockSeconds(CLOCK_THREAD_CPUTIME_ID));
+    for (double seconds : ThreadPool::shared().workerCpuSeconds()) s.threadCpu.push_back(seconds);
+    return s;
+}
+
+void RunProfile::begin(const std::string& phase) {
+    end();
+    current_ = phase;
+    resetPeakRss();
+    start_ = snapshot();
+    open_ = true;
+}
+
+void RunProfile::end() {
+    if (!open_) return;
+    open_ = false;
+    Snapshot stop = snapshot();
+
+    Phase phase;
+    phase.name = current_;
+    phase.wall = std::chrono::duration<double>(stop.wall - start_.wall).count();
+    phase.cpu = stop.processCpu - start_.processCpu;
+    for (size_t t = 0; t < std::min(start_.threadCpu.size(), stop.threadCpu.size()); ++t) {
+        phase.threadBusy.push_back(stop.threadCpu[t] - start_.threadCpu[t]);
+    }
+    phase.peakRssKb = peakRssKb();
+    phases_.push_back(std::move(phase));
+}
+
+void RunProfile::count(const std::string& name, long long value) {
+    counts_.emplace_back(name, value);
+}
+
+void RunProfile::metrics(const std::string& name, const Metrics& m) {
+    metrics_.emplace_back(name, m);
+}
+
+void RunProfile::write(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open profile file: " + filename);
+    }
+    bool csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+    if (csv) writeCsv(out);
+    else writeJson(out);
+}
+
+static std::string quoted(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Non-finite values have no JSON number; they become null
+static std::string number(double value) {
+    if (!std::isfinite(value)) return "null";
+    std::ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+static const std::pair<const char*, double Metrics::*> METRIC_SCORES[] = {
+    {"accuracy", &Metrics::accuracy}, {"precision", &Metrics::precision}, {"recall", &Metrics::recall},
+    {"f1", &Metrics::f1}, {"mcc", &Metrics::mcc}};
+
+void RunProfile::writeJson(std::ostream& out) const {
+    double wall = 0, cpu = 0;
+    long peak = 0;
+    for (const auto& phase : phases_) {
+        wall += phase.wall;
+        cpu += phase.cpu;
+        peak = std::max(peak, phase.peakRssKb);
+    }
+
+    out << "{\n  \"input\": " << quoted(input_) << ",\n  \"algorithm\": " << quoted(algorithm_)
+        << ",\n  \"threads\": " << threads_
+        << ",\n  \"total\": {\"wall_seconds\": " << number(wall) << ", \"cpu_seconds\": " << number(cpu)
+        << ", \"peak_rss_kb\": " << peak << "},\n  \"phases\": [\n";
+    for (size_t p = 0; p < phases_.size(); ++p) {
+        const Phase& phase = phases_[p];
+        out << "    {\"name\": " << quoted(phase.name) << ", \"wall_seconds\": " << number(phase.wall)
+            << ", \"cpu_seconds\": " << number(phase.cpu) << ", \"peak_rss_kb\": " << phase.peakRssKb << ", \"threads\": [";
+        for (size_t t = 0; t < phase.threadBusy.size(); ++t) {
+            out << (t ? ", " : "") << "{\"busy_seconds\": " << number(phase.threadBusy[t])
+                << ", \"idle_seconds\": " << number(std::max(0.0, phase.wall - phase.threadBusy[t])) << "}";
+        }
+        out << "]}" << (p + 1 < phases_.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"counts\": {";
+    for (size_t c = 0; c < counts_.size(); ++c) {
+        out << (c ? ", " : "") << quoted(counts_[c].first) << ": " << counts_[c].second;
+    }
+    out << "},\n  \"metrics\": {";
+    for (size_t i = 0; i < metrics_.size(); ++i) {
+        const Metrics& m = metrics_[i].second;
+        out << (i ? ", " : "") << quoted(metrics_[i].first) << ": {\"tp\": " << m.tp << ", \"fp\": " << m.fp
+            << ", \"tn\": " << m.tn << ", \"fn\": " << m.fn;
+        for (const auto& [name, score] : METRIC_SCORES) out << ", \"" << name << "\": " << number(m.*score);
+        out << "}";
+    }
+    out << "}\n}\n";
+}
+
+// One value per row, keyed by input and algorithm, so profiles of many runs
+// can be concatenated (minus their headers) and grouped directly
+void RunProfile::writeCsv(std::ostream& out) const {
+    out << "input,algorithm,section,name,key,value\n";
+    auto row = [&](const char* section, const std::string& name, const std::string& key, const std::string& value) {
+        out << input_ << "," << algorithm_ << "," << section << "," << name << "," << key << "," << value << "\n";
+    };
+    row("run", "", "threads", std::to_string(threads_));
+    for (const auto& phase : phases_) {
+        row("phase", phase.name, "wall_seconds", number(phase.wall));
+        row("phase", phase.name, "cpu_seconds", number(phase.cpu));
+        row("phase", phase.name, "peak_rss_kb", std::to_string(phase.peakRssKb));
+        for (size_t t = 0; t < phase.threadBusy.size(); ++t) {
+            std::string thread = phase.name + ":" + std::to_string(t);
+            row("thread", thread, "busy_seconds", number(phase.threadBusy[t]));
+            row("thread", thread, "idle_seconds", number(std::max(0.0, phase.wall - phase.threadBusy[t])));
+        }
+    }
+    for (const auto& [name, value] : counts_) row("count", name, "value", std::to_string(value));
+    for (const auto& [name, m] : metrics_) {
+        row("metric", name, "tp", std::to_string(m.tp));
+        row("metric", name, "fp", std::to_string(m.fp));
+        row("metric", name, "tn", std::to_string(m.tn));
+        row("metric", name, "fn", std::to_string(m.fn));
+        for (const auto& [key, score] : METRIC_SCORES) row("metric", name, key, std::isfinite(m.*score) ? number(m.*score) : "");
+    }
+}
@@ -0,0 +1,67 @@
+// profile.h
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include "prophage_signal_processor.h"
+
+// Peak resident set size of the process in kB (VmHWM, or ru_maxrss).
+long peakRssKb();
+// Restarts the peak-RSS mark so the next peakRssKb() covers only what follows.
+// Returns false on kernels without /proc/self/clear_refs.
+bool resetPeakRss();
+
+// Runs of 1s in labels, counting a run that crosses a contig boundary once
+// per contig.
+long long countClusters(const BitLabels& labels, const std::vector<ContigRange>& contigs);
+
+// Windows switched 0 -> 1 and 1 -> 0 between input and output labels.
+std::pair<long long, long long> countFlips(const BitLabels& input, const BitLabels& output);
+
+// Wall time, CPU time, per-thread busy time and peak RSS of each phase of a
+// run, plus counts and metrics, written by --profile as JSON or (for a .csv
+// path) as long-format CSV rows that concatenate across runs.
+class RunProfile {
+public:
+    RunProfile(std::string input, std::string algorithm, int threads);
+
+    // Phases are sequential: begin() ends the previous one
+    void begin(const std::string& phase);
+    void end();
+
+    void count(const std::string& name, long long value);
+    void metrics(const std::string& name, const Metrics& m);
+
+    void write(const std::string& filename) const;
+
+private:
+    // Clocks at a phase boundary. threadCpu[0] is the calling thread,
+    // the rest are the shared pool's workers.
+    struct Snapshot {
+        std::chrono::steady_clock::time_point wall;
+        double processCpu = 0;
+        std::vector<double> threadCpu;
+    };
+    struct Phase {
+        std::string name;
+        double wall = 0, cpu = 0;
+        std::vector<double> threadBusy;
+        long peakRssKb = 0;
+    };
+
+    static Snapshot snapshot();
+    void writeJson(std::ostream& out) const;
+    void writeCsv(std::ostream& out) const;
+
+    std::string input_, algorithm_;
+    int threads_;
+    bool open_ = false;
+    Snapshot start_;
+    std::string current_;
+    std::vector<Phase> phases_;
+    std::vector<std::pair<std::string, long long>> counts_;
+    std::vector<std::pair<std::string, Metrics>> metrics_;
+};
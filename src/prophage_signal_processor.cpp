@@ -7,283 +7,299 @@
 #include <algorithm>
 #include <cstring>
 #include <unordered_set>
-#include <queue>
+#include <set>
 #include <thread>
 #include <mutex>
 #include <atomic>
 #include <cmath>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "track_file.h"
+
+int algorithmParameterCount(const std::string& name) {
+    if (name == "mwa" || name == "pmwa" || name == "dbscan" || name == "ccl" || name == "hmm") return 2;
+    if (name == "rle" || name == "median") return 1;
+    return -1;
+}
 
-int main(int argc, char* argv[]) {
-    if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <input_file> <output_file> <algorithm> [parameters] [num_threads]\n";
-        std::cerr << "Use -h or --help for more information.\n";
-        return 1;
-    }
-
-    if (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") {
-        printHelp();
-        return 0;
-    }
-
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
-    std::string algorithm = argv[3];
-    int numThreads = std::thread::hardware_concurrency();
-
-    auto [input, trueLabels] = readCSV(inputFile);
-    std::vector<int> output;
-
-    enum AlgorithmType { MWA, RLE, DBSCAN, MEDIAN, CCL, UNKNOWN };
-    AlgorithmType algoType = UNKNOWN;
-
-    if (algorithm == "mwa") algoType = MWA;
-    else if (algorithm == "rle") algoType = RLE;
-    else if (algorithm == "dbscan") algoType = DBSCAN;
-    else if (algorithm == "median") algoType = MEDIAN;
-    else if (algorithm == "ccl") algoType = CCL;
-
-    switch (algoType) {
-        case MWA:
-            if (argc < 6) {
-                std::cerr << "Moving Window Average requires window size and threshold.\n";
-                return 1;
-            }
-            {
-                int windowSize = std::stoi(argv[4]);
-                double threshold = std::stod(argv[5]);
-                if (argc >= 7) numThreads = std::stoi(argv[6]);
-                output = movingWindowAverage(input, windowSize, threshold, numThreads);
-            }
-            break;
-
-        case RLE:
-            if (argc < 5) {
-                std::cerr << "Run Length Encoding requires minimum length.\n";
-                return 1;
-            }
-            {
-                int minLength = std::stoi(argv[4]);
-                if (argc >= 6) numThreads = std::stoi(argv[5]);
-                output = runLengthEncoding(input, minLength, numThreads);
-            }
-            break;
-
-        case DBSCAN:
-            if (argc < 6) {
-                std::cerr << "DBSCAN requires eps and minPts.\n";
-                return 1;
-            }
-            {
-                int eps = std::stoi(argv[4]);
-                int minPts = std::stoi(argv[5]);
-                if (argc >= 7) numThreads = std::stoi(argv[6]);
-                output = dbscan(input, eps, minPts, numThreads);
-            }
-            break;
+bool readsScores(const std::string& name) {
+    return name == "pmwa" || name == "hmm";
+}
 
-        case MEDIAN:
-            if (argc < 5) {
-                std::cerr << "Median Filter requires window size.\n";
-                return 1;
-            }
-            {
-                int windowSize = std::stoi(argv[4]);
-                if (argc >= 6) numThreads = std::stoi(argv[5]);
-                output = medianFilter(input, windowSize, numThreads);
-            }
-            break;
+AlgorithmConfig parseAlgorithmSpec(const std::string& spec) {
+    AlgorithmConfig config;
+    std::istringstream iss(spec);
+    std::getline(iss, config.name, ':');
+    std::string param;
+    while (std::getline(iss, param, ':')) config.params.push_back(param);
 
-        case CCL:
-            if (argc < 6) {
-                std::cerr << "Connected Component Labeling requires minimum size and gap tolerance.\n";
-            return 1;
-            }
-            {
-            int minSize = std::stoi(argv[4]);
-            int gapTolerance = std::stoi(argv[5]);
-            if (argc >= 7) numThreads = std::stoi(argv[6]);
-                output = connectedComponentLabeling(input, minSize, gapTolerance, numThreads);
-            }
-            break;
+    int paramCount = algorithmParameterCount(config.name);
+    if (paramCount < 0) {
+        throw std::invalid_argument("Unknown algorithm: " + config.name);
+    }
+    if (static_cast<int>(config.params.size()) != paramCount) {
+        throw std::invalid_argument("Algorithm '" + config.name + "' takes " + std::to_string(paramCount) + " parameter(s): " + spec);
+    }
+    return config;
+}
 
-        case UNKNOWN:
-        default:
-            std::cerr << "Unknown algorithm: " << algorithm << "\n";
-            return 1;
+Pipeline parsePipelineSpec(const std::string& spec) {
+    Pipeline pipeline;
+    size_t begin = 0;
+    while (true) {
+        size_t bar = spec.find('|', begin);
+        pipeline.push_back(parseAlgorithmSpec(spec.substr(begin, bar == std::string::npos ? std::string::npos : bar - begin)));
+        if (readsScores(pipeline.back().name) && pipeline.size() > 1) {
+            throw std::invalid_argument(pipeline.back().name + " reads prob_1 scores, so it can only be the first stage: " + spec);
+        }
+        if (bar == std::string::npos) return pipeline;
+        begin = bar + 1;
     }
+}
 
-    writeCSV(outputFile, output);
-    std::cout << "Processing complete. Output written to " << outputFile << "\n";
+Pipeline parseAlgorithmArguments(const std::vector<std::string>& args, size_t index, size_t* next) {
+    const std::string& name = args.at(index);
+    if (name.find_first_of(":|") != std::string::npos) {
+        if (next) *next = index + 1;
+        return parsePipelineSpec(name);
+    }
+    AlgorithmConfig config;
+    config.name = name;
+    int paramCount = algorithmParameterCount(name);
+    if (paramCount < 0) {
+        throw std::invalid_argument("Unknown algorithm: " + name);
+    }
+    size_t end = std::min(args.size(), index + 1 + paramCount);
+    for (size_t i = index + 1; i < end; ++i) config.params.push_back(args[i]);
+    if (next) *next = end;
+    return {config};
+}
 
-    calculateMetrics(trueLabels, input, output);
+std::string pipelineSpec(const Pipeline& pipeline) {
+    std::string result;
+    for (const auto& stage : pipeline) result += (result.empty() ? "" : "|") + stage.spec();
+    return result;
+}
 
-    return 0;
+std::string AlgorithmConfig::spec() const {
+    std::string result = name;
+    for (const auto& param : params) result += ":" + param;
+    return result;
 }
 
-std::vector<int> movingWindowAverage(const std::vector<int>& input, int windowSize, double threshold, int numThreads) {
-    std::vector<int> output(input.size(), 0);
-    std::vector<std::thread> threads;
-    
-    auto worker = [&](int start, int end) {
-        int sum = 0;
-        for (int i = start; i < end; ++i) {
-            sum += input[i];
-            if (i >= windowSize) sum -= input[i - windowSize];
-            
-            if (i >= windowSize - 1) {
-                double avg = static_cast<double>(sum) / windowSize;
-                output[i - windowSize / 2] = (avg >= threshold) ? 1 : 0;
-            }
+Algorithm AlgorithmConfig::algorithm() const {
+    auto require = [&](size_t count, const char* message) {
+        if (params.size() < count) throw std::invalid_argument(message);
+    };
+    // Lengths take an optional bp suffix, e.g. ccl:4000bp:800bp; the lengths
+    // of one spec must share a unit
+    bool inWindows = false, inBasePairs = false;
+    auto length = [&](size_t i) {
+        const std::string& value = params[i];
+        bool bp = value.size() > 2 && value.compare(value.size() - 2, 2, "bp") == 0;
+        (bp ? inBasePairs : inWindows) = true;
+        return std::stoi(bp ? value.substr(0, value.size() - 2) : value);
+    };
+    auto typed = [&](Algorithm algorithm) {
+        if (inWindows && inBasePairs) {
+            throw std::invalid_argument(spec() + " mixes lengths in bp and in windows.");
         }
+        algorithm.basePairs = inBasePairs;
+        return algorithm;
     };
-
-    int chunkSize = input.size() / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        int start = i * chunkSize;
-        int end = (i == numThreads - 1) ? input.size() : (i + 1) * chunkSize;
-        threads.emplace_back(worker, start, end);
+    if (name == "mwa") {
+        require(2, "Moving Window Average requires window size and threshold.");
+        return typed(Algorithm::mwa(length(0), std::stod(params[1])));
     }
-
-    for (auto& thread : threads) {
-        thread.join();
+    if (name == "pmwa") {
+        require(2, "Probability-weighted MWA requires window size and threshold.");
+        return typed(Algorithm::pmwa(length(0), std::stod(params[1])));
     }
-
-    return output;
+    if (name == "rle") {
+        require(1, "Run Length Encoding requires minimum length.");
+        return typed(Algorithm::rle(length(0)));
+    }
+    if (name == "dbscan") {
+        require(2, "DBSCAN requires eps and minPts.");
+        return typed(Algorithm::dbscan(length(0), std::stoi(params[1])));
+    }
+    if (name == "median") {
+        require(1, "Median Filter requires window size.");
+        return typed(Algorithm::median(length(0)));
+    }
+    if (name == "ccl") {
+        require(2, "Connected Component Labeling requires minimum size and gap tolerance.");
+        return typed(Algorithm::ccl(length(0), length(1)));
+    }
+    if (name == "hmm") {
+        require(2, "HMM requires enter and exit probabilities.");
+        return Algorithm::hmm(std::stod(params[0]), std::stod(params[1]));
+    }
+    throw std::invalid_argument("Unknown algorithm: " + name);
 }
 
-std::vector<int> runLengthEncoding(const std::vector<int>& input, int minLength, int numThreads) {
-    std::vector<int> output(input.size(), 0);
-    std::vector<std::pair<int, int>> runs;
-    std::mutex runsMutex;
+bool usesBasePairs(const Pipeline& pipeline) {
+    return std::any_of(pipeline.begin(), pipeline.end(),
+                       [](const AlgorithmConfig& config) { return config.algorithm().basePairs; });
+}
 
-    auto worker = [&](int start, int end) {
-        int count = 0;
-        int runStart = -1;
-        
-        for (int i = start; i < end; ++i) {
-            if (input[i] == 1) {
-                if (count == 0) runStart = i;
-                count++;
-            } else {
-                if (count >= minLength) {
-                    std::lock_guard<std::mutex> lock(runsMutex);
-                    runs.emplace_back(runStart, i);
-                }
-                count = 0;
-            }
-        }
-        
-        if (count >= minLength) {
-            std::lock_guard<std::mutex> lock(runsMutex);
-            runs.emplace_back(runStart, end);
-        }
-    };
+Algorithm parseAlgorithm(const std::string& spec) {
+    return parseAlgorithmSpec(spec).algorithm();
+}
 
-    std::vector<std::thread> threads;
-    int chunkSize = input.size() / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        int start = i * chunkSize;
-        int end = (i == numThreads - 1) ? input.size() : (i + 1) * chunkSize;
-        threads.emplace_back(worker, start, end);
+template <typename Labels>
+Labels runAlgorithm(const AlgorithmConfig& config, const Labels& input, int numThreads) {
+    Algorithm algorithm = config.algorithm();
+    if (algorithm.basePairs) {
+        throw std::invalid_argument(config.spec() + ": lengths in bp need window coordinates, from a label CSV or .pstrack with --coord-col.");
     }
-
-    for (auto& thread : threads) {
-        thread.join();
+    switch (algorithm.type) {
+        case ALGORITHM_MWA:
+            return movingWindowAverage(input, algorithm.windowSize, algorithm.threshold, numThreads);
+        case ALGORITHM_RLE:
+            return runLengthEncoding(input, algorithm.minSize, numThreads);
+        case ALGORITHM_DBSCAN:
+            return dbscan(input, algorithm.eps, algorithm.minPts, numThreads);
+        case ALGORITHM_MEDIAN:
+            return medianFilter(input, algorithm.windowSize, numThreads);
+        case ALGORITHM_CCL:
+            return connectedComponentLabeling(input, algorithm.minSize, algorithm.gapTolerance, numThreads);
+        case ALGORITHM_PMWA:
+        case ALGORITHM_HMM:
+        default:
+            throw std::invalid_argument(config.name + " needs prob_1 scores: raw inference output or a .pstrack with prob_1.");
     }
+}
 
-    for (const auto& run : runs) {
-        std::fill(output.begin() + run.first, output.begin() + run.second, 1);
-    }
+template std::vector<int> runAlgorithm(const AlgorithmConfig&, const std::vector<int>&, int);
+template BitLabels runAlgorithm(const AlgorithmConfig&, const BitLabels&, int);
 
-    return output;
+int minimumWindowSum(int windowSize, double threshold) {
+    // avg >= NaN never holds
+    if (threshold != threshold) return windowSize + 1;
+
+    double scaled = std::ceil(threshold * windowSize);
+    int k = (scaled <= 0) ? 0 : (scaled > windowSize) ? windowSize + 1 : static_cast<int>(scaled);
+    // Correct any rounding in the product so the result agrees with sum / windowSize >= threshold
+    while (k > 0 && static_cast<double>(k - 1) / windowSize >= threshold) --k;
+    while (k <= windowSize && static_cast<double>(k) / windowSize < threshold) ++k;
+    return k;
 }
 
-std::vector<int> dbscan(const std::vector<int>& input, int eps, int minPts, int numThreads) {
+// Threads fill disjoint ranges of the output and each starts its window count
+// afresh, so every thread count gives identical output
+static std::vector<int> windowCountFilter(const std::vector<int>& input, const WindowCount& window, int numThreads) {
     std::vector<int> output(input.size(), 0);
-    std::vector<std::atomic<bool>> visited(input.size());
-    std::vector<std::mutex> pointMutexes(input.size());
-
-    auto expandCluster = [&](int point) {
-        std::queue<int> seeds;
-        seeds.push(point);
+    ThreadPool::shared().parallelFor(0, input.size(), PARALLEL_GRAIN, numThreads, [&](size_t, size_t start, size_t end) {
+        windowCountRange(Span<const int>(input), Span<int>(output), window, static_cast<long long>(start),
+                         static_cast<long long>(end));
+    });
+    return output;
+}
 
-        while (!seeds.empty()) {
-            int currentPoint = seeds.front();
-            seeds.pop();
+std::vector<int> movingWindowAverage(const std::vector<int>& input, int windowSize, double threshold, int numThreads) {
+    return windowCountFilter(input, mwaWindowCount(input.size(), windowSize, threshold), numThreads);
+}
 
-            if (!visited[currentPoint].load()) {
-                visited[currentPoint].store(true);
-                if (input[currentPoint] == 1) {
-                    std::lock_guard<std::mutex> lock(pointMutexes[currentPoint]);
-                    output[currentPoint] = 1;
+// The run-based algorithms go through runAlgorithmByContig, which cuts long
+// inputs at runs of 0s no run, component or chain spans and runs the pieces
+// on separate threads; each piece is one *Into call on the packed labels
+static std::vector<int> runInPieces(const AlgorithmConfig& config, const std::vector<int>& input, int numThreads) {
+    BitLabels bits(input.size());
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (input[i] != 0) bits.set(i);
+    }
+    return runAlgorithmByContig(config, bits, {}, numThreads).toInts();
+}
 
-                    for (int i = std::max(0, currentPoint - eps); i < std::min(static_cast<int>(input.size()), currentPoint + eps + 1); ++i) {
-                        if (!visited[i].load()) seeds.push(i);
-                    }
-                }
-            }
-        }
-    };
+std::vector<int> runLengthEncoding(const std::vector<int>& input, int minLength, int numThreads) {
+    return runInPieces({"rle", {std::to_string(minLength)}}, input, numThreads);
+}
 
-    auto worker = [&](int start, int end) {
-        for (int i = start; i < end; ++i) {
-            if (!visited[i].load() && input[i] == 1) {
-                int count = 0;
-                for (int j = std::max(0, i - eps); j < std::min(static_cast<int>(input.size()), i + eps + 1); ++j) {
-                    if (input[j] == 1) count++;
-                }
+std::vector<int> dbscan(const std::vector<int>& input, int eps, int minPts, int numThreads) {
+    return runInPieces({"dbscan", {std::to_string(eps), std::to_string(minPts)}}, input, numThreads);
+}
 
-                if (count >= minPts) {
-                    expandCluster(i);
-                }
+// Window i covers [i - windowSize / 2, i - windowSize / 2 + windowSize), with
+// positions outside the input read as 0, and its median is the element at
+// index windowSize / 2 of the sorted window.
+
+// Median of an arbitrary-valued window kept as two multisets: low holds the
+// windowSize / 2 + 1 smallest values, so its maximum is the median. Sliding
+// recycles the outgoing node with extract(), so steps do not allocate.
+template <typename T>
+static void slidingMedianChunk(const std::vector<T>& input, std::vector<T>& output, int windowSize, int start, int end) {
+    int n = static_cast<int>(input.size());
+    int half = windowSize / 2;
+    size_t lowSize = static_cast<size_t>(half) + 1;
+    auto valueAt = [&](int idx) { return (idx >= 0 && idx < n) ? input[idx] : T(0); };
+
+    std::multiset<T> low, high;
+    std::vector<T> initial(windowSize);
+    for (int j = 0; j < windowSize; ++j) initial[j] = valueAt(start - half + j);
+    std::sort(initial.begin(), initial.end());
+    low.insert(initial.begin(), initial.begin() + lowSize);
+    high.insert(initial.begin() + lowSize, initial.end());
+
+    for (int i = start; i < end; ++i) {
+        if (i > start) {
+            T outgoing = valueAt(i - 1 - half);
+            T incoming = valueAt(i - 1 - half + windowSize);
+
+            bool fromLow = outgoing <= *low.rbegin();
+            auto node = fromLow ? low.extract(low.find(outgoing)) : high.extract(high.find(outgoing));
+            node.value() = incoming;
+            if (!low.empty() && incoming <= *low.rbegin()) low.insert(std::move(node));
+            else high.insert(std::move(node));
+
+            if (low.size() > lowSize) {
+                high.insert(low.extract(std::prev(low.end())));
+            } else if (low.size() < lowSize) {
+                low.insert(high.extract(high.begin()));
+            } else if (!high.empty() && *low.rbegin() > *high.begin()) {
+                auto lowMax = low.extract(std::prev(low.end()));
+                auto highMin = high.extract(high.begin());
+                std::swap(lowMax.value(), highMin.value());
+                low.insert(std::move(lowMax));
+                high.insert(std::move(highMin));
             }
         }
-    };
-
-    std::vector<std::thread> threads;
-    int chunkSize = input.size() / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        int start = i * chunkSize;
-        int end = (i == numThreads - 1) ? input.size() : (i + 1) * chunkSize;
-        threads.emplace_back(worker, start, end);
+        output[i] = *low.rbegin();
     }
+}
 
-    for (auto& thread : threads) {
-        thread.join();
-    }
+template <typename T>
+static std::vector<T> slidingMedian(const std::vector<T>& input, int windowSize, int numThreads) {
+    int n = static_cast<int>(input.size());
+    std::vector<T> output(n);
+    if (n == 0) return output;
+
+    ThreadPool::shared().parallelFor(0, n, PARALLEL_GRAIN, numThreads, [&](size_t, size_t start, size_t end) {
+        slidingMedianChunk(input, output, windowSize, static_cast<int>(start), static_cast<int>(end));
+    });
 
     return output;
 }
 
 std::vector<int> medianFilter(const std::vector<int>& input, int windowSize, int numThreads) {
-    std::vector<int> output(input.size());
-
-    auto worker = [&](int start, int end) {
-        std::vector<int> window(windowSize);
-        for (int i = start; i < end; ++i) {
-            for (int j = 0; j < windowSize; ++j) {
-                int idx = i - windowSize / 2 + j;
-                window[j] = (idx >= 0 && idx < input.size()) ? input[idx] : 0;
-            }
-
-            std::sort(window.begin(), window.end());
-            output[i] = window[windowSize / 2];
-        }
-    };
-
-    std::vector<std::thread> threads;
-    int chunkSize = input.size() / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        int start = i * chunkSize;
-        int end = (i == numThreads - 1) ? input.size() : (i + 1) * chunkSize;
-        threads.emplace_back(worker, start, end);
+    if (windowSize < 1) {
+        throw std::invalid_argument("Median Filter requires a positive window size.");
     }
+    bool binary = std::all_of(input.begin(), input.end(), [](int v) { return v == 0 || v == 1; });
+    if (!binary) return slidingMedian(input, windowSize, numThreads);
 
-    for (auto& thread : threads) {
-        thread.join();
-    }
+    // With 0/1 values the sorted window holds its 1s last, so the median is a window count
+    return windowCountFilter(input, medianWindowCount(input.size(), windowSize), numThreads);
+}
 
-    return output;
+std::vector<float> medianFilter(const std::vector<float>& input, int windowSize, int numThreads) {
+    if (windowSize < 1) {
+        throw std::invalid_argument("Median Filter requires a positive window size.");
+    }
+    return slidingMedian(input, windowSize, numThreads);
 }
 
 /*
@@ -324,92 +340,197 @@ std::vector<int> connectedComponentLabeling(const std::vector<int>& input, int m
 }
 */
 std::vector<int> connectedComponentLabeling(const std::vector<int>& input, int minSize, int gapTolerance, int numThreads) {
-    std::vector<int> output(input.size(), 0);
-    std::vector<int> labels(input.size(), 0);
-    std::atomic<int> currentLabel(1);
+    return runInPieces({"ccl", {std::to_string(minSize), std::to_string(gapTolerance)}}, input, numThreads);
+}
 
-    auto worker = [&](int start, int end) {
-        for (int i = start; i < end; ++i) {
-            if (input[i] == 1 && labels[i] == 0) {
-                int componentStart = i;
-                int label = currentLabel.fetch_add(1);
-                
-                // Forward pass: label and expand
-                while (i < end) {
-                    labels[i] = label;
-                    ++i;
-                    // Check for gap
-                    int gapSize = 0;
-                    while (i < end && input[i] == 0 && gapSize < gapTolerance) {
-                        labels[i] = label;
-                        ++i;
-                        ++gapSize;
-                    }
-                    if (i < end && input[i] == 1) {
-                        continue; // Continue expanding
-                    } else {
-                        break; // End of component
-                    }
+int findColumn(const char* begin, const char* end, const std::string& name) {
+    int column = 0;
+    const char* field = begin;
+    while (field <= end) {
+        const char* comma = static_cast<const char*>(std::memchr(field, ',', end - field));
+        const char* fieldEnd = comma ? comma : end;
+        if (fieldEnd > field && fieldEnd[-1] == '\r') --fieldEnd;
+        if (static_cast<size_t>(fieldEnd - field) == name.size() && std::equal(name.begin(), name.end(), field)) {
+            return column;
+        }
+        if (!comma) break;
+        field = comma + 1;
+        ++column;
+    }
+    return -1;
+}
+
+// Scans the label and truth columns of a CSV, calling begin(rows, hasTruth,
+// hasCoord) once with an upper bound on the row count and then
+// row(label, truth, contig, coord, line) for every data row. truth is 0 when
+// the file has no truth column; contig is the raw contigColumn field, or
+// empty when contigColumn is empty; coord is the coordColumn value, or 0 when
+// coordColumn is empty or not in the file.
+template <typename Begin, typename Row>
+static void scanLabelColumns(const std::string& filename, const std::string& labelColumn,
+                             const std::string& truthColumn, const std::string& contigColumn,
+                             const std::string& coordColumn, const std::string& scoreColumn,
+                             Begin&& begin, Row&& row) {
+    MappedFile file(filename);
+    const char* p = file.data();
+    const char* end = file.end();
+    if (p == end) {
+        begin(0, false, false, false);
+        return;
+    }
+
+    // Resolve columns from the header
+    const char* headerEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (!headerEnd) headerEnd = end;
+    int labelIndex = findColumn(p, headerEnd, labelColumn);
+    int truthIndex = findColumn(p, headerEnd, truthColumn);
+    int contigIndex = contigColumn.empty() ? -1 : findColumn(p, headerEnd, contigColumn);
+    int coordIndex = coordColumn.empty() ? -1 : findColumn(p, headerEnd, coordColumn);
+    int scoreIndex = scoreColumn.empty() ? -1 : findColumn(p, headerEnd, scoreColumn);
+    if (labelIndex < 0) {
+        throw std::runtime_error("Column '" + labelColumn + "' not found in " + filename);
+    }
+    if (!contigColumn.empty() && contigIndex < 0) {
+        throw std::runtime_error("Column '" + contigColumn + "' not found in " + filename);
+    }
+    p = (headerEnd < end) ? headerEnd + 1 : end;
+    int lastIndex = std::max({labelIndex, truthIndex, contigIndex, coordIndex, scoreIndex});
+
+    begin(static_cast<size_t>(std::count(p, end, '\n')) + 1, truthIndex >= 0, coordIndex >= 0, scoreIndex >= 0);
+
+    // Read data
+    size_t lineNumber = 1;
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+        ++lineNumber;
+
+        if (lineEnd > p && !(lineEnd - p == 1 && *p == '\r')) {
+            int values[2] = {0, 0};
+            long long coord = 0;
+            double score = 0;
+            std::string_view contig;
+            const char* field = p;
+            // A number must fill its field: "1.0" or "1abc" is not a label
+            auto parsed = [&](std::from_chars_result result) {
+                return result.ec == std::errc() &&
+                       (result.ptr == lineEnd || *result.ptr == ',' || (*result.ptr == '\r' && result.ptr + 1 == lineEnd));
+            };
+            for (int i = 0; i <= lastIndex; ++i) {
+                if (field > lineEnd) {
+                    throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": missing column");
                 }
-                
-                // Backward pass: expand in reverse direction
-                for (int j = componentStart - 1; j >= start && componentStart - j <= gapTolerance; --j) {
-                    if (input[j] == 1) {
-                        componentStart = j;
-                        break;
+                if (i == labelIndex || i == truthIndex) {
+                    if (!parsed(std::from_chars(field, lineEnd, values[i == labelIndex ? 0 : 1]))) {
+                        throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": invalid integer");
                     }
-                    labels[j] = label;
                 }
-                
-                // Check component size and set output
-                int componentSize = i - componentStart;
-                if (componentSize >= minSize) {
-                    std::fill(output.begin() + componentStart, output.begin() + i, 1);
+                if (i == coordIndex && !parsed(std::from_chars(field, lineEnd, coord))) {
+                    throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": invalid " + coordColumn);
+                }
+                if (i == scoreIndex && !parsed(std::from_chars(field, lineEnd, score))) {
+                    throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": invalid " + scoreColumn);
+                }
+                if (i < lastIndex || i == contigIndex) {
+                    const char* comma = static_cast<const char*>(std::memchr(field, ',', lineEnd - field));
+                    if (i == contigIndex) {
+                        const char* fieldEnd = comma ? comma : lineEnd;
+                        if (fieldEnd > field && fieldEnd[-1] == '\r') --fieldEnd;
+                        contig = std::string_view(field, fieldEnd - field);
+                    }
+                    field = comma ? comma + 1 : lineEnd + 1;
                 }
             }
+            row(values[0], values[1], contig, coord, score, lineNumber);
         }
-    };
-
-    std::vector<std::thread> threads;
-    int chunkSize = input.size() / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        int start = i * chunkSize;
-        int end = (i == numThreads - 1) ? input.size() : (i + 1) * chunkSize;
-        threads.emplace_back(worker, start, end);
+        p = lineEnd + 1;
     }
+}
 
-    for (auto& thread : threads) {
-        thread.join();
+std::pair<std::vector<int>, std::vector<int>> readCSV(const std::string& filename,
+                                                      const std::string& labelColumn,
+                                                      const std::string& truthColumn) {
+    if (isTrackFile(filename)) {
+        auto [labels, trueLabels] = readLabelBits(filename, labelColumn, truthColumn);
+        return {labels.toInts(), trueLabels.toInts()};
     }
 
-    return output;
-}
-
-std::pair<std::vector<int>, std::vector<int>> readCSV(const std::string& filename) {
     std::vector<int> labels;
     std::vector<int> trueLabels;
-    std::ifstream file(filename);
-    std::string line;
+    bool hasTruth = false;
+    scanLabelColumns(filename, labelColumn, truthColumn, "", "", "",
+        [&](size_t rows, bool truth, bool, bool) {
+            hasTruth = truth;
+            labels.reserve(rows);
+            if (hasTruth) trueLabels.reserve(rows);
+        },
+        [&](int label, int truth, std::string_view, long long, double, size_t) {
+            labels.push_back(label);
+            if (hasTruth) trueLabels.push_back(truth);
+        });
 
-    // Read header
-    std::getline(file, line);
-    
-    // Read data
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string token;
-        int i = 0;
-        while (std::getline(iss, token, ',')) {
-            if (i == 1) { // Assuming "labels" is the second column (index 1)
-                labels.push_back(std::stoi(token));
-            } else if (i == 3) { // Assuming "true_labels" is the third column (index 3)
-                trueLabels.push_back(std::stoi(token));
+    return {labels, trueLabels};
+}
+
+std::pair<BitLabels, BitLabels> readLabelBits(const std::string& filename,
+                                              const std::string& labelColumn,
+                                              const std::string& truthColumn) {
+    LabelTrack track = readLabelTrack(filename, labelColumn, truthColumn, "");
+    return {std::move(track.labels), std::move(track.trueLabels)};
+}
+
+LabelTrack readLabelTrack(const std::string& filename, const std::string& labelColumn,
+                          const std::string& truthColumn, const std::string& contigColumn,
+                          const std::string& coordColumn, const std::string& scoreColumn) {
+    LabelTrack result;
+    BitLabels& labels = result.labels;
+    BitLabels& trueLabels = result.trueLabels;
+    std::vector<ContigRange>& contigs = result.contigs;
+
+    // Binary tracks from process_csv --binary are already bit-packed
+    if (isTrackFile(filename)) {
+        TrackFile track(filename);
+        labels = track.bits(labelColumn);
+        if (track.find(truthColumn)) trueLabels = track.bits(truthColumn);
+        if (!coordColumn.empty() && track.find(coordColumn)) result.coords = track.integers(coordColumn);
+        if (!scoreColumn.empty() && track.find(scoreColumn)) result.scores = track.floats(scoreColumn);
+        if (!contigColumn.empty()) {
+            std::vector<long long> ids = track.integers(contigColumn);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (i == 0 || ids[i] != ids[i - 1]) contigs.push_back({std::to_string(ids[i]), i, i});
+                contigs.back().end = i + 1;
             }
-            i++;
         }
+    } else {
+        bool hasTruth = false, hasCoord = false, hasScore = false;
+        scanLabelColumns(filename, labelColumn, truthColumn, contigColumn, coordColumn, scoreColumn,
+            [&](size_t rows, bool truth, bool coord, bool score) {
+                hasTruth = truth;
+                hasCoord = coord;
+                hasScore = score;
+                labels.reserve(rows);
+                if (hasTruth) trueLabels.reserve(rows);
+                if (hasCoord) result.coords.reserve(rows);
+                if (hasScore) result.scores.reserve(rows);
+            },
+            [&](int label, int truth, std::string_view contig, long long coord, double score, size_t lineNumber) {
+                if ((label | truth) & ~1) {
+                    throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": labels must be 0 or 1");
+                }
+                // A new range starts whenever the sequence id changes
+                if (!contigColumn.empty() && (contigs.empty() || contigs.back().name != contig)) {
+                    contigs.push_back({std::string(contig), labels.size(), labels.size()});
+                }
+                labels.push_back(label);
+                if (hasTruth) trueLabels.push_back(truth);
+                if (hasCoord) result.coords.push_back(coord);
+                if (hasScore) result.scores.push_back(static_cast<float>(score));
+                if (!contigs.empty()) contigs.back().end = labels.size();
+            });
     }
 
-    return {labels, trueLabels};
+    if (contigs.empty()) contigs.push_back({"", 0, labels.size()});
+    return result;
 }
 
 void writeCSV(const std::string& filename, const std::vector<int>& data) {
@@ -420,47 +541,83 @@ void writeCSV(const std::string& filename, const std::vector<int>& data) {
     }
 }
 
-void calculateMetrics(const std::vector<int>& trueLabels, const std::vector<int>& predictedLabels, const std::vector<int>& clusteredLabels) {
-    auto calculateMetricsForLabels = [](const std::vector<int>& true_labels, const std::vector<int>& pred_labels) {
-        int tp = 0, fp = 0, tn = 0, fn = 0;
-        for (size_t i = 0; i < true_labels.size(); ++i) {
-            if (true_labels[i] == 1 && pred_labels[i] == 1) tp++;
-            else if (true_labels[i] == 0 && pred_labels[i] == 1) fp++;
-            else if (true_labels[i] == 0 && pred_labels[i] == 0) tn++;
-            else if (true_labels[i] == 1 && pred_labels[i] == 0) fn++;
+void writeCSV(const std::string& filename, const BitLabels& data) {
+    std::ofstream file(filename, std::ios::binary);
+    std::string buffer = "label\n";
+    buffer.reserve(1 << 16);
+    for (size_t i = 0; i < data.size(); ++i) {
+        buffer += data.get(i) ? '1' : '0';
+        buffer += '\n';
+        if (buffer.size() >= (1 << 16) - 2) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
         }
+    }
+    file.write(buffer.data(), buffer.size());
+}
 
-        double accuracy = static_cast<double>(tp + tn) / (tp + tn + fp + fn);
-        double precision = static_cast<double>(tp) / (tp + fp);
-        double recall = static_cast<double>(tp) / (tp + fn);
-        double f1 = 2 * (precision * recall) / (precision + recall);
-        
-        double mcc_numerator = static_cast<double>(tp * tn - fp * fn);
-        double mcc_denominator = std::sqrt(static_cast<double>(tp + fp) * (tp + fn) * (tn + fp) * (tn + fn));
-        double mcc = mcc_numerator / mcc_denominator;
-
-        std::cout << "Accuracy: " << accuracy << std::endl;
-        std::cout << "Precision: " << precision << std::endl;
-        std::cout << "Recall: " << recall << std::endl;
-        std::cout << "F1 Score: " << f1 << std::endl;
-        std::cout << "MCC: " << mcc << std::endl;
-    };
+Metrics metricsFromCounts(long long tp, long long fp, long long tn, long long fn) {
+    Metrics m;
+    m.tp = tp;
+    m.fp = fp;
+    m.tn = tn;
+    m.fn = fn;
+
+    // A score whose denominator is 0 (no windows, no predicted or no true
+    // positives) is 0 rather than NaN, as the scripts used to patch it
+    auto ratio = [](double numerator, double denominator) { return denominator > 0 ? numerator / denominator : 0.0; };
+    double dtp = static_cast<double>(tp), dfp = static_cast<double>(fp);
+    double dtn = static_cast<double>(tn), dfn = static_cast<double>(fn);
+    m.accuracy = ratio(dtp + dtn, dtp + dtn + dfp + dfn);
+    m.precision = ratio(dtp, dtp + dfp);
+    m.recall = ratio(dtp, dtp + dfn);
+    m.f1 = ratio(2 * (m.precision * m.recall), m.precision + m.recall);
+    m.mcc = ratio(dtp * dtn - dfp * dfn, std::sqrt((dtp + dfp) * (dtp + dfn) * (dtn + dfp) * (dtn + dfn)));
+    return m;
+}
+
+Metrics computeMetrics(const std::vector<int>& trueLabels, const std::vector<int>& labels) {
+    // Branch-free sums of 0/1 products, which the compiler vectorizes; values
+    // other than 0 and 1 count in no cell, as before
+    long long tp = 0, fp = 0, tn = 0, fn = 0;
+    size_t n = std::min(trueLabels.size(), labels.size());
+    for (size_t i = 0; i < n; ++i) {
+        int t1 = trueLabels[i] == 1, t0 = trueLabels[i] == 0;
+        int l1 = labels[i] == 1, l0 = labels[i] == 0;
+        tp += t1 & l1;
+        fp += t0 & l1;
+        tn += t0 & l0;
+        fn += t1 & l0;
+    }
+    return metricsFromCounts(tp, fp, tn, fn);
+}
+
+void printMetrics(const Metrics& m, std::ostream& out) {
+    out << "Accuracy: " << m.accuracy << std::endl;
+    out << "Precision: " << m.precision << std::endl;
+    out << "Recall: " << m.recall << std::endl;
+    out << "F1 Score: " << m.f1 << std::endl;
+    out << "MCC: " << m.mcc << std::endl;
+}
+
+template <typename Labels>
+static void printMetricsBeforeAfter(const Labels& trueLabels, const Labels& predictedLabels, const Labels& clusteredLabels) {
+    if (trueLabels.empty()) {
+        std::cout << "No truth labels available, skipping metrics." << std::endl;
+        return;
+    }
 
     std::cout << "Metrics before clustering:" << std::endl;
-    calculateMetricsForLabels(trueLabels, predictedLabels);
+    printMetrics(computeMetrics(trueLabels, predictedLabels), std::cout);
 
     std::cout << "\nMetrics after clustering:" << std::endl;
-    calculateMetricsForLabels(trueLabels, clusteredLabels);
-}
-
-void printHelp() {
-     std::cout << "Usage: prophage_signal_processor <input_file> <output_file> <algorithm> [parameters] [num_threads]\n\n"
-              << "Algorithms:\n"
-              << "  mwa <window_size> <threshold>   : Moving Window Average\n"
-              << "  rle <min_length>                : Run Length Encoding\n"
-              << "  dbscan <eps> <min_pts>          : DBSCAN\n"
-              << "  median <window_size>            : Median Filter\n"
-              << "  ccl <min_size>                  : Connected Component Labeling\n\n"
-              << "Example:\n"
-              << "  prophage_signal_processor input.csv output.csv mwa 5 0.6 4\n";
+    printMetrics(computeMetrics(trueLabels, clusteredLabels), std::cout);
+}
+
+void calculateMetrics(const std::vector<int>& trueLabels, const std::vector<int>& predictedLabels, const std::vector<int>& clusteredLabels) {
+    printMetricsBeforeAfter(trueLabels, predictedLabels, clusteredLabels);
+}
+
+void calculateMetrics(const BitLabels& trueLabels, const BitLabels& predictedLabels, const BitLabels& clusteredLabels) {
+    printMetricsBeforeAfter(trueLabels, predictedLabels, clusteredLabels);
 }
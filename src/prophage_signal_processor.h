@@ -0,0 +1,186 @@
+// prophage_signal_processor.h
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bit_labels.h"
+#include "phagesignal.h"
+
+// An algorithm name plus its positional parameters, e.g. "ccl:40:8".
+struct AlgorithmConfig {
+    std::string name;
+    std::vector<std::string> params;
+
+    std::string spec() const;
+    // Typed parameters, checked and converted once; throws std::invalid_argument
+    Algorithm algorithm() const;
+};
+
+// Per-window confusion counts and the scores derived from them.
+struct Metrics {
+    long long tp = 0, fp = 0, tn = 0, fn = 0;
+    double accuracy = 0, precision = 0, recall = 0, f1 = 0, mcc = 0;
+};
+
+// Algorithms applied in order, each to the previous one's output.
+using Pipeline = std::vector<AlgorithmConfig>;
+
+// Number of positional parameters the algorithm takes, or -1 if unknown.
+int algorithmParameterCount(const std::string& name);
+// True for algorithms that cluster prob_1 scores rather than labels (pmwa, hmm)
+bool readsScores(const std::string& name);
+AlgorithmConfig parseAlgorithmSpec(const std::string& spec);
+// Stage specs joined by '|', e.g. "median:5|ccl:40:8"; a single spec is a
+// one-stage pipeline. pmwa and hmm read prob_1, so they may only be the first stage.
+Pipeline parsePipelineSpec(const std::string& spec);
+std::string pipelineSpec(const Pipeline& pipeline);
+// True when a stage gives its lengths in bp (e.g. ccl:4000bp:800bp), which
+// only the coordinate-aware sparse track runs
+bool usesBasePairs(const Pipeline& pipeline);
+// Algorithm from the command line at args[index]: either a name followed by
+// its positional parameters, or a spec / pipeline spec in one argument.
+// *next is set to the first argument after it.
+Pipeline parseAlgorithmArguments(const std::vector<std::string>& args, size_t index, size_t* next = nullptr);
+// Runs the configured algorithm; instantiated for std::vector<int> and BitLabels.
+template <typename Labels>
+Labels runAlgorithm(const AlgorithmConfig& config, const Labels& input, int numThreads);
+
+// Smallest range of windows the std::vector<int> algorithms hand to another thread
+constexpr size_t PARALLEL_GRAIN = size_t(1) << 14;
+
+// The algorithms on whole inputs: wrappers over the *Into templates of
+// phagesignal.h. Window filters (mwa, median) split their windows across
+// numThreads threads; rle, ccl and dbscan are cut into pieces at long runs of
+// 0s by runAlgorithmByContig. Any nonzero label counts as 1; a median over
+// values other than 0 and 1 takes the sliding-median path instead.
+std::vector<int> movingWindowAverage(const std::vector<int>& input, int windowSize, double threshold, int numThreads);
+std::vector<int> runLengthEncoding(const std::vector<int>& input, int minLength, int numThreads);
+std::vector<int> dbscan(const std::vector<int>& input, int eps, int minPts, int numThreads);
+std::vector<int> medianFilter(const std::vector<int>& input, int windowSize, int numThreads);
+// Median filter over continuous scores such as prob_1
+std::vector<float> medianFilter(const std::vector<float>& input, int windowSize, int numThreads);
+std::vector<int> connectedComponentLabeling(const std::vector<int>& input, int minSize, int gapTolerance, int numThreads);
+
+// Bit-packed versions, over the same templates; the output is the same for
+// any thread count. rle, ccl and dbscan scan on one thread here; go through
+// runAlgorithmByContig to spread a long input across threads.
+BitLabels movingWindowAverage(const BitLabels& input, int windowSize, double threshold, int numThreads);
+BitLabels runLengthEncoding(const BitLabels& input, int minLength, int numThreads);
+BitLabels dbscan(const BitLabels& input, int eps, int minPts, int numThreads);
+BitLabels medianFilter(const BitLabels& input, int windowSize, int numThreads);
+BitLabels connectedComponentLabeling(const BitLabels& input, int minSize, int gapTolerance, int numThreads);
+
+// Rows [begin, end) sharing one value of the sequence-id column
+struct ContigRange {
+    std::string name;
+    size_t begin = 0, end = 0;
+};
+
+// Labels read by readLabelTrack. contigs always covers every row: one unnamed
+// range when no sequence-id column is used. coords holds the coordinate
+// column per row, or is empty when there is none; scores likewise holds the
+// score column (prob_1) when one was asked for and found.
+struct LabelTrack {
+    BitLabels labels, trueLabels;
+    std::vector<ContigRange> contigs;
+    std::vector<long long> coords;
+    std::vector<float> scores;
+};
+
+// contigs.cpp: runs the algorithm on each contig independently, so clusters
+// never cross a contig boundary. Long contigs are split into sub-chunks
+// whose results are exact; all pieces are shared between numThreads workers.
+BitLabels runAlgorithmByContig(const AlgorithmConfig& config, const BitLabels& input,
+                               const std::vector<ContigRange>& contigs, int numThreads);
+// Runs each stage by contig on the previous stage's output, which is exactly
+// sequential application with no file in between.
+BitLabels runPipelineByContig(const Pipeline& pipeline, const BitLabels& input,
+                              const std::vector<ContigRange>& contigs, int numThreads);
+// As above on a track; a first stage that reads scores runs on track.scores.
+// A pipeline with lengths in bp runs on the sparse track (sparse_track.h).
+BitLabels runPipelineByContig(const Pipeline& pipeline, const LabelTrack& track, int numThreads);
+// pmwa or hmm on each contig's scores
+BitLabels runScoresByContig(const AlgorithmConfig& config, const std::vector<float>& scores,
+                            const std::vector<ContigRange>& contigs, int numThreads);
+
+// hmm.cpp: most likely host (0) / prophage (1) path per contig under a
+// two-state HMM whose emissions are the prob_1 scores, by log-space Viterbi.
+// Contigs are decoded several at a time across SIMD lanes and threads, and
+// the traceback recomputes sqrt(n)-window blocks from checkpoints, so memory
+// beyond the scores and output is O(sqrt(n)) per contig.
+BitLabels viterbiSegment(const std::vector<float>& scores, const std::vector<ContigRange>& contigs,
+                         double enterProbability, double exitProbability, int numThreads);
+
+// Returns the index of the named column in a comma-separated header line
+// [begin, end), or -1.
+int findColumn(const char* begin, const char* end, const std::string& name);
+
+// Reads the predicted label column and the truth column, selected by header
+// name, from a CSV or a .pstrack file written by process_csv --binary. The
+// truth vector is left empty when the file has no such column.
+std::pair<std::vector<int>, std::vector<int>> readCSV(const std::string& filename,
+                                                      const std::string& labelColumn = "label",
+                                                      const std::string& truthColumn = "reference");
+// readCSV straight into bit-packed labels; values other than 0/1 are an error.
+std::pair<BitLabels, BitLabels> readLabelBits(const std::string& filename,
+                                              const std::string& labelColumn = "label",
+                                              const std::string& truthColumn = "reference");
+// readLabelBits plus contig ranges split wherever contigColumn (when not
+// empty) changes value between consecutive rows, and the coordColumn and
+// scoreColumn values when the file has those columns.
+LabelTrack readLabelTrack(const std::string& filename, const std::string& labelColumn,
+                          const std::string& truthColumn, const std::string& contigColumn,
+                          const std::string& coordColumn = "", const std::string& scoreColumn = "");
+// predictions.cpp: true for raw inference output ("SeqID,prediction" header)
+// and for a .pstrack made from it, i.e. one with prob_1 but no labelColumn.
+bool isPredictionInput(const std::string& filename, const std::string& labelColumn = "label");
+// Thresholds prob_1 at threshold and runs the pipeline in the same pass,
+// from raw inference output or a .pstrack with a prob_1 column. A leading
+// pmwa clusters on the probabilities themselves. The thresholded labels are
+// stored in *thresholded when it is not null.
+BitLabels clusterPredictions(const std::string& filename, double threshold, const Pipeline& pipeline,
+                             BitLabels* thresholded = nullptr);
+void writeCSV(const std::string& filename, const std::vector<int>& data);
+void writeCSV(const std::string& filename, const BitLabels& data);
+Metrics metricsFromCounts(long long tp, long long fp, long long tn, long long fn);
+Metrics computeMetrics(const std::vector<int>& trueLabels, const std::vector<int>& labels);
+Metrics computeMetrics(const BitLabels& trueLabels, const BitLabels& labels);
+void printMetrics(const Metrics& m, std::ostream& out);
+void calculateMetrics(const std::vector<int>& trueLabels, const std::vector<int>& predictedLabels, const std::vector<int>& clusteredLabels);
+void calculateMetrics(const BitLabels& trueLabels, const BitLabels& predictedLabels, const BitLabels& clusteredLabels);
+void printHelp();
+
+// Expands a directory into its .csv and .pstrack files (sorted), passes a
+// single such file through, and otherwise reads a manifest with one path per line. Relative
+// manifest entries are resolved against the manifest's directory.
+std::vector<std::string> collectInputFiles(const std::string& source);
+
+// batch.cpp: runs a list of algorithms over many genomes in one process.
+// A non-empty contigColumn keeps clusters within each contig; coordColumn is
+// read for pipelines with lengths in bp.
+int runBatch(const std::vector<std::string>& args, const std::string& labelColumn, const std::string& truthColumn,
+             const std::string& contigColumn, const std::string& coordColumn, const std::string& scoreColumn);
+// Indexes of the files shard `shard` of `shards` runs: a greedy partition by
+// file size that depends only on the list and the sizes, so independent
+// processes agree on it.
+std::vector<size_t> shardFiles(const std::vector<std::string>& files, int shard, int shards);
+// batch.cpp: combines the partial counts of every batch --shard into the batch tables.
+int runMerge(const std::vector<std::string>& args);
+// batch.cpp: reports the entries of a --cache directory and the hits and misses of the runs that used it.
+int runCacheStats(const std::vector<std::string>& args);
+
+// sweep.cpp: evaluates parameter grids for mwa, rle and ccl from shared per-genome structures.
+// A non-empty contigColumn keeps clusters within each contig, as in batch mode.
+int runSweep(const std::vector<std::string>& args, const std::string& labelColumn, const std::string& truthColumn,
+             const std::string& contigColumn);
+
+// stream.cpp: runs one algorithm over rows read incrementally from a file or stdin.
+// A non-empty contigColumn restarts the algorithm wherever that column changes.
+int runStream(const std::vector<std::string>& args, const std::string& labelColumn, const std::string& truthColumn,
+              const std::string& contigColumn);
+
+// bench.cpp: times the algorithms and the CSV paths on real and synthetic inputs, as JSON.
+int runBench(const std::vector<std::string>& args);
@@ -0,0 +1,166 @@
+// result_cache.cpp
+
+#include "result_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+#include "intervals.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+
+constexpr uint64_t HASH_PRIME_1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t HASH_PRIME_2 = 0xc2b2ae3d27d4eb4fULL;
+
+static uint64_t rotateLeft(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t finalMix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Two independent lanes of one multiply per 8-byte word, so hashing runs
+// at several GB/s and costs little next to parsing the same file
+static std::string hashBytes(const char* data, size_t size) {
+    uint64_t a = HASH_PRIME_1 ^ size, b = HASH_PRIME_2 + size;
+    auto round = [&](uint64_t word) {
+        a = rotateLeft(a ^ (word * HASH_PRIME_2), 31) * HASH_PRIME_1;
+        b = rotateLeft(b + word, 29) * HASH_PRIME_2;
+    };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        round(word);
+    }
+    uint64_t tail = 0;
+    if (size > i) std::memcpy(&tail, data + i, size - i);  // data may be null when size is 0
+    round(tail);
+    a = finalMix(a ^ b);
+    b = finalMix(b + a);
+
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", static_cast<unsigned long long>(a), static_cast<unsigned long long>(b));
+    return hex;
+}
+
+std::string hashFile(const std::string& filename) {
+    MappedFile file(filename);
+    return hashBytes(file.data(), file.size());
+}
+
+std::string hashString(const std::string& text) {
+    return hashBytes(text.data(), text.size());
+}
+
+const std::string& binaryVersion() {
+    static const std::string version = [] {
+        try {
+            return hashFile("/proc/self/exe");
+        } catch (const std::exception&) {
+            return hashString(__DATE__ " " __TIME__);
+        }
+    }();
+    return version;
+}
+
+ResultCache::ResultCache(const std::string& directory) : directory_(directory) {
+    fs::create_directories(directory_);
+}
+
+std::string ResultCache::key(const std::string& inputHash, const std::string& context, const std::string& spec) {
+    return hashString(binaryVersion() + "\n" + inputHash + "\n" + context + "\n" + spec);
+}
+
+std::string ResultCache::entryPath(const std::string& key, const char* extension) const {
+    return (fs::path(directory_) / key.substr(0, 2) / (key + extension)).string();
+}
+
+bool ResultCache::lookup(const std::string& key, Metrics* metrics) {
+    std::ifstream in(entryPath(key, ".counts"));
+    long long tp, fp, tn, fn;
+    if (!(in >> tp >> fp >> tn >> fn)) {
+        ++misses_;
+        return false;
+    }
+    *metrics = metricsFromCounts(tp, fp, tn, fn);
+    ++hits_;
+    return true;
+}
+
+void ResultCache::store(const std::string& key, const Metrics& metrics, const BitLabels* labels,
+                        const std::vector<ContigRange>* contigs) {
+    fs::create_directories(fs::path(directory_) / key.substr(0, 2));
+
+    // Unique per process and call, so two writers of one key never share a temporary
+    static std::atomic<unsigned long> serial{0};
+    std::string suffix = ".tmp" + std::to_string(::getpid()) + "_" + std::to_string(serial++);
+
+    // The labels go first: a .counts file marks a complete entry
+    if (labels) {
+        std::string path = entryPath(key, ".psruns");
+        writeRuns(path + suffix, *labels, contigs ? *contigs : std::vector<ContigRange>{{"", 0, labels->size()}});
+        fs::rename(path + suffix, path);
+    }
+    std::string path = entryPath(key, ".counts");
+    {
+        std::ofstream out(path + suffix);
+        out << metrics.tp << " " << metrics.fp << " " << metrics.tn << " " << metrics.fn << "\n";
+        if (!out) {
+            throw std::runtime_error("Could not write cache entry: " + path);
+        }
+    }
+    fs::rename(path + suffix, path);
+}
+
+void ResultCache::recordRun(const std::string& command) const {
+    std::ostringstream line;
+    line << std::time(nullptr) << "," << command << "," << hits_ << "," << misses_ << "\n";
+    // One write of one short line, so lines from concurrent runs do not interleave
+    std::ofstream out(fs::path(directory_) / "stats.csv", std::ios::app);
+    out << line.str() << std::flush;
+}
+
+CacheStats readCacheStats(const std::string& directory, size_t recent) {
+    if (!fs::is_directory(directory)) {
+        throw std::runtime_error("No cache directory: " + directory);
+    }
+    CacheStats stats;
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        if (!entry.is_regular_file()) continue;
+        stats.bytes += static_cast<long long>(entry.file_size());
+        if (entry.path().extension() == ".counts") ++stats.entries;
+        if (entry.path().extension() == ".psruns") ++stats.labelFiles;
+    }
+
+    std::ifstream in(fs::path(directory) / "stats.csv");
+    std::deque<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string time, command, hits, misses;
+        if (!std::getline(fields, time, ',') || !std::getline(fields, command, ',') ||
+            !std::getline(fields, hits, ',') || !std::getline(fields, misses)) {
+            continue;
+        }
+        ++stats.runs;
+        stats.hits += std::stoll(hits);
+        stats.misses += std::stoll(misses);
+        lines.push_back(line);
+        if (lines.size() > recent) lines.pop_front();
+    }
+    stats.recentRuns.assign(lines.begin(), lines.end());
+    return stats;
+}
@@ -0,0 +1,59 @@
+// result_cache.h
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "prophage_signal_processor.h"
+
+// 128-bit hash of a file's contents or of a string, as 32 hex digits. Not
+// cryptographic; it only has to tell inputs apart.
+std::string hashFile(const std::string& filename);
+std::string hashString(const std::string& text);
+// Hash of the running executable, so a rebuilt binary never reuses results
+// of the old one. Falls back to the build date where /proc is missing.
+const std::string& binaryVersion();
+
+// Clustering results stored under a key derived from everything that
+// determines them: the input file's contents, the options that pick its
+// columns, the pipeline spec and the binary version. An entry is
+//
+//   <directory>/<key[0..2]>/<key>.counts   "tp fp tn fn"
+//   <directory>/<key[0..2]>/<key>.psruns   the output labels (see intervals.h), when stored
+//
+// Files are written under a temporary name and renamed into place, so
+// concurrent runs, such as the shards of one batch, can share a directory.
+class ResultCache {
+public:
+    explicit ResultCache(const std::string& directory);
+
+    // context names the command and column options, e.g. "batch;label=label;truth=reference"
+    static std::string key(const std::string& inputHash, const std::string& context, const std::string& spec);
+
+    // Fills *metrics from the stored counts; counts a hit or a miss
+    bool lookup(const std::string& key, Metrics* metrics);
+    // Stores the counts and, when labels is not null, the output labels
+    void store(const std::string& key, const Metrics& metrics, const BitLabels* labels = nullptr,
+               const std::vector<ContigRange>* contigs = nullptr);
+
+    long long hits() const { return hits_; }
+    long long misses() const { return misses_; }
+    // Appends one "time,command,hits,misses" line to <directory>/stats.csv
+    void recordRun(const std::string& command) const;
+
+private:
+    std::string entryPath(const std::string& key, const char* extension) const;
+
+    std::string directory_;
+    std::atomic<long long> hits_{0}, misses_{0};
+};
+
+// Totals over a cache directory, for the cache-stats report
+struct CacheStats {
+    long long entries = 0, labelFiles = 0, bytes = 0;
+    long long runs = 0, hits = 0, misses = 0;
+    // The last few lines of stats.csv, oldest first
+    std::vector<std::string> recentRuns;
+};
+CacheStats readCacheStats(const std::string& directory, size_t recent = 10);
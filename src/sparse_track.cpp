@@ -0,0 +1,326 @@
+// sparse_track.cpp
+
+#include "sparse_track.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include "thread_pool.h"
+
+SparseTrack buildSparseTrack(const BitLabels& labels, const std::vector<ContigRange>& contigs,
+                             const std::vector<long long>& coords) {
+    if (!coords.empty() && coords.size() != labels.size()) {
+        throw std::invalid_argument("coordinate column has " + std::to_string(coords.size()) + " rows, labels have " +
+                                    std::to_string(labels.size()));
+    }
+    std::vector<ContigRange> ranges = contigs;
+    if (ranges.empty()) ranges.push_back({"", 0, labels.size()});
+
+    SparseTrack track;
+    track.rows = labels.size();
+    track.stride = coords.empty() ? 1 : 0;
+    for (const auto& contig : ranges) {
+        for (size_t r = contig.begin + 1; r < contig.end && !coords.empty(); ++r) {
+            long long step = coords[r] - coords[r - 1];
+            if (step <= 0) {
+                throw std::invalid_argument("window coordinates must increase within a contig, but row " +
+                                            std::to_string(r + 1) + " is at " + std::to_string(coords[r]) +
+                                            " after " + std::to_string(coords[r - 1]));
+            }
+            track.stride = std::gcd(track.stride, step);
+        }
+    }
+
+    for (const auto& contig : ranges) {
+        SparseContig sparse;
+        sparse.begin = contig.begin;
+        sparse.end = contig.end;
+        if (contig.begin < contig.end) {
+            auto position = [&](size_t row) {
+                if (coords.empty()) return static_cast<long long>(row - contig.begin);
+                return track.stride > 0 ? (coords[row] - coords[contig.begin]) / track.stride : 0;
+            };
+            sparse.origin = coords.empty() ? 0 : coords[contig.begin];
+            sparse.positions = position(contig.end - 1) + 1;
+            for (size_t r = contig.begin; r < contig.end; ++r) {
+                if (r == contig.begin || position(r) != position(r - 1) + 1) sparse.segments.emplace_back(position(r), r);
+                // Without coordinates the rows are one segment
+                if (coords.empty()) break;
+            }
+
+            // Runs of rows, cut where a position is missing
+            size_t s = 0;
+            size_t pos = contig.begin;
+            while (true) {
+                size_t begin = labels.findNextOne(pos);
+                if (begin >= contig.end) break;
+                size_t end = std::min(labels.findNextZero(begin), contig.end);
+                for (size_t row = begin; row < end;) {
+                    while (s + 1 < sparse.segments.size() && sparse.segments[s + 1].second <= row) ++s;
+                    size_t segmentEnd = s + 1 < sparse.segments.size() ? sparse.segments[s + 1].second : contig.end;
+                    size_t pieceEnd = std::min(end, segmentEnd);
+                    long long first = sparse.segments[s].first + static_cast<long long>(row - sparse.segments[s].second);
+                    sparse.runs.emplace_back(first, first + static_cast<long long>(pieceEnd - row));
+                    row = pieceEnd;
+                }
+                pos = end;
+            }
+        }
+        track.contigs.push_back(std::move(sparse));
+    }
+    return track;
+}
+
+// Calls f(position, row, length) for each stretch of runs that lies on
+// windows present in the contig
+template <typename F>
+static void forEachPresent(const SparseContig& contig, const SparseRuns& runs, F&& f) {
+    const auto& segments = contig.segments;
+    size_t s = 0;
+    for (auto [a, b] : runs) {
+        while (a < b && s < segments.size()) {
+            long long segmentBegin = segments[s].first;
+            size_t endRow = s + 1 < segments.size() ? segments[s + 1].second : contig.end;
+            long long segmentEnd = segmentBegin + static_cast<long long>(endRow - segments[s].second);
+            if (segmentEnd <= a) {
+                ++s;
+                continue;
+            }
+            long long from = std::max(a, segmentBegin), to = std::min(b, segmentEnd);
+            if (from >= to) break;
+            f(from, segments[s].second + static_cast<size_t>(from - segmentBegin), to - from);
+            a = to;
+        }
+    }
+}
+
+BitLabels denseLabels(const SparseTrack& track) {
+    BitLabels output(track.rows);
+    for (const auto& contig : track.contigs) {
+        forEachPresent(contig, contig.runs, [&](long long, size_t row, long long length) {
+            output.fill(row, row + static_cast<size_t>(length));
+        });
+    }
+    return output;
+}
+
+static void appendRun(SparseRuns& runs, long long begin, long long end) {
+    if (!runs.empty() && runs.back().second == begin) runs.back().second = end;
+    else runs.emplace_back(begin, end);
+}
+
+static SparseRuns sparseRLE(const SparseRuns& runs, long long minLength) {
+    SparseRuns output;
+    for (const auto& run : runs) {
+        if (run.second - run.first >= minLength) output.push_back(run);
+    }
+    return output;
+}
+
+// Runs at most gapTolerance positions apart join one component, which then
+// reaches gapTolerance positions past its last run, as in connectedComponentLabeling
+static SparseRuns sparseCCL(const SparseRuns& runs, long long positions, long long minSize, long long gapTolerance) {
+    long long gap = std::max(0LL, gapTolerance);
+    SparseRuns output;
+    for (size_t r = 0; r < runs.size();) {
+        long long start = runs[r].first, last = runs[r].second;
+        for (++r; r < runs.size() && runs[r].first - last <= gap; ++r) last = runs[r].second;
+        long long end = std::min(last + gap, positions);
+        if (end - start >= minSize) output.emplace_back(start, end);
+    }
+    return output;
+}
+
+// A chain is runs whose neighbouring 1s are at most eps apart; it is kept
+// whole when any of its 1s has at least minPts 1s within eps. That count
+// changes by at most one per position, so its maximum over a run lies at
+// an end of the run or where the reach x +- eps starts losing a run
+// (x = first + eps) or stops gaining one (x = last - eps).
+static SparseRuns sparseDBSCAN(const SparseRuns& runs, long long eps, long long minPts) {
+    if (eps < 0) return minPts <= 0 ? runs : SparseRuns();
+
+    // ones[i] = 1s in runs [0, i)
+    std::vector<long long> ones(runs.size() + 1, 0);
+    for (size_t i = 0; i < runs.size(); ++i) ones[i + 1] = ones[i] + runs[i].second - runs[i].first;
+    auto onesUpTo = [&](long long y) {
+        size_t i = std::upper_bound(runs.begin(), runs.end(), y,
+                                    [](long long value, const std::pair<long long, long long>& run) { return value < run.first; }) -
+                   runs.begin();
+        if (i == 0) return 0LL;
+        return ones[i - 1] + std::min(y + 1, runs[i - 1].second) - runs[i - 1].first;
+    };
+    auto isCore = [&](long long x) { return onesUpTo(x + eps) - onesUpTo(x - eps - 1) >= minPts; };
+
+    SparseRuns output;
+    size_t chainBegin = 0, leaving = 0, gaining = 0;
+    bool core = false;
+    for (size_t r = 0; r < runs.size(); ++r) {
+        auto [a, b] = runs[r];
+        if (r > 0 && a - (runs[r - 1].second - 1) > eps) {
+            if (core) output.insert(output.end(), runs.begin() + chainBegin, runs.begin() + r);
+            chainBegin = r;
+            core = false;
+        }
+        core = core || isCore(a) || isCore(b - 1);
+        while (leaving < runs.size() && runs[leaving].first + eps < a) ++leaving;
+        while (gaining < runs.size() && runs[gaining].second - 1 - eps < a) ++gaining;
+        for (size_t q = leaving; !core && q < runs.size() && runs[q].first + eps < b; ++q) core = isCore(runs[q].first + eps);
+        for (size_t q = gaining; !core && q < runs.size() && runs[q].second - 1 - eps < b; ++q) core = isCore(runs[q].second - 1 - eps);
+    }
+    if (core) output.insert(output.end(), runs.begin() + chainBegin, runs.end());
+    return output;
+}
+
+// Sets positions j in [validBegin, validEnd) whose window
+// [j - lowOffset, j - lowOffset + windowSize) holds at least minCount 1s, as
+// windowCountInto does. The count rises by one per step while the window's
+// leading edge is in a run and falls by one while its trailing edge is, so
+// between the four slope changes each run adds it is linear in j and its
+// threshold crossing is solved directly.
+static SparseRuns sparseWindowCount(const SparseRuns& runs, long long lowOffset, long long windowSize, long long minCount,
+                                    long long validBegin, long long validEnd) {
+    SparseRuns output;
+    if (validBegin >= validEnd || minCount > windowSize) return output;
+    if (minCount <= 0) {
+        output.emplace_back(validBegin, validEnd);
+        return output;
+    }
+
+    long long high = windowSize - 1 - lowOffset;
+    std::vector<std::pair<long long, long long>> steps;  // (j, change of slope)
+    steps.reserve(runs.size() * 4);
+    for (const auto& [a, b] : runs) {
+        steps.emplace_back(a - high, 1);
+        steps.emplace_back(b - high, -1);
+        steps.emplace_back(a + lowOffset + 1, -1);
+        steps.emplace_back(b + lowOffset + 1, 1);
+    }
+    std::sort(steps.begin(), steps.end());
+
+    long long countBefore = 0, slope = 0;  // count at p - 1, and its change per step from p on
+    for (size_t e = 0; e < steps.size();) {
+        long long p = steps[e].first;
+        while (e < steps.size() && steps[e].first == p) slope += steps[e++].second;
+        long long next = e < steps.size() ? steps[e].first : validEnd;
+
+        // count(j) = countBefore + slope * (j - p + 1) for j in [p, next)
+        long long from = p, to = std::max(p, next);
+        if (slope == 0) {
+            if (countBefore < minCount) from = to;
+        } else if (slope > 0) {
+            long long need = minCount - countBefore;
+            if (need > 0) from = p - 1 + (need + slope - 1) / slope;
+        } else {
+            long long spare = countBefore - minCount;
+            if (spare < 0) from = to;
+            else to = std::min(to, p + spare / -slope);
+        }
+        from = std::max(from, validBegin);
+        to = std::min(to, validEnd);
+        if (from < to) appendRun(output, from, to);
+        countBefore += slope * (next - p);
+    }
+    return output;
+}
+
+// Lengths in bp as grid positions: distances round down, minimum sizes up
+static Algorithm onGrid(const Algorithm& algorithm, long long stride) {
+    if (!algorithm.basePairs) return algorithm;
+    if (stride <= 0) {
+        throw std::invalid_argument("Lengths in bp need the window size, but no contig has two windows to measure it from.");
+    }
+    auto atLeast = [&](int bp) { return bp > 0 ? static_cast<int>((bp + stride - 1) / stride) : 0; };
+    auto within = [&](int bp) { return bp >= 0 ? static_cast<int>(bp / stride) : -1; };
+    Algorithm grid = algorithm;
+    grid.basePairs = false;
+    switch (algorithm.type) {
+        case ALGORITHM_MWA:
+        case ALGORITHM_MEDIAN:
+            if (algorithm.windowSize % stride != 0) {
+                throw std::invalid_argument("window of " + std::to_string(algorithm.windowSize) +
+                                            " bp is not a whole number of " + std::to_string(stride) + " bp windows.");
+            }
+            grid.windowSize = static_cast<int>(algorithm.windowSize / stride);
+            break;
+        case ALGORITHM_RLE:
+            grid.minSize = atLeast(algorithm.minSize);
+            break;
+        case ALGORITHM_CCL:
+            grid.minSize = atLeast(algorithm.minSize);
+            grid.gapTolerance = within(algorithm.gapTolerance);
+            break;
+        case ALGORITHM_DBSCAN:
+            grid.eps = within(algorithm.eps);
+            break;
+        default:
+            break;
+    }
+    return grid;
+}
+
+SparseTrack clusterSparse(const Algorithm& algorithm, const SparseTrack& track, int numThreads) {
+    if (algorithm.readsScores()) {
+        throw std::invalid_argument("pmwa and hmm read prob_1 scores, which the sparse track does not hold.");
+    }
+    Algorithm grid = onGrid(algorithm, track.stride);
+    if (grid.type == ALGORITHM_MWA && grid.windowSize < 1) {
+        throw std::invalid_argument("Moving Window Average requires a positive window size.");
+    }
+    if (grid.type == ALGORITHM_MEDIAN && grid.windowSize < 1) {
+        throw std::invalid_argument("Median Filter requires a positive window size.");
+    }
+
+    SparseTrack output;
+    output.rows = track.rows;
+    output.stride = track.stride;
+    output.contigs.resize(track.contigs.size());
+    ThreadPool::shared().forEachIndex(track.contigs.size(), numThreads, [&](size_t c) {
+        const SparseContig& contig = track.contigs[c];
+        SparseRuns runs;
+        long long window = grid.windowSize, half = window / 2;
+        switch (grid.type) {
+            case ALGORITHM_MWA:
+                // The window ending at i is written to i - windowSize / 2
+                runs = sparseWindowCount(contig.runs, window - 1 - half, window, minimumWindowSum(grid.windowSize, grid.threshold),
+                                         window - 1 - half, contig.positions - half);
+                break;
+            case ALGORITHM_MEDIAN:
+                // Zero-padded window centred on j; the median is 1 with window - half ones
+                runs = sparseWindowCount(contig.runs, half, window, window - half, 0, contig.positions);
+                break;
+            case ALGORITHM_RLE:
+                runs = sparseRLE(contig.runs, grid.minSize);
+                break;
+            case ALGORITHM_CCL:
+                runs = sparseCCL(contig.runs, contig.positions, grid.minSize, grid.gapTolerance);
+                break;
+            default:
+                runs = sparseDBSCAN(contig.runs, grid.eps, grid.minPts);
+                break;
+        }
+
+        // Missing windows stay 0, so later stages see the same gaps
+        SparseContig& result = output.contigs[c];
+        result.begin = contig.begin;
+        result.end = contig.end;
+        result.origin = contig.origin;
+        result.positions = contig.positions;
+        result.segments = contig.segments;
+        forEachPresent(contig, runs, [&](long long position, size_t, long long length) {
+            appendRun(result.runs, position, position + length);
+        });
+    });
+    return output;
+}
+
+BitLabels runSparsePipeline(const Pipeline& pipeline, const LabelTrack& track, int numThreads) {
+    std::vector<Algorithm> stages;
+    for (const auto& config : pipeline) {
+        stages.push_back(config.algorithm());
+        if (stages.back().basePairs && track.coords.empty()) {
+            throw std::invalid_argument(config.spec() + ": lengths in bp need a window coordinate column (--coord-col).");
+        }
+    }
+    SparseTrack sparse = buildSparseTrack(track.labels, track.contigs, track.coords);
+    for (const auto& stage : stages) sparse = clusterSparse(stage, sparse, numThreads);
+    return denseLabels(sparse);
+}
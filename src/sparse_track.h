@@ -0,0 +1,51 @@
+// sparse_track.h
+
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "prophage_signal_processor.h"
+
+// [first, end) grid positions of consecutive 1s
+using SparseRuns = std::vector<std::pair<long long, long long>>;
+
+// One contig on its coordinate grid: position k is the window starting at
+// origin + k * stride bp. Windows missing from the input, such as masked
+// regions, are positions without a row; they read as 0 and are never set.
+struct SparseContig {
+    size_t begin = 0, end = 0;  // rows of the contig in the dense track
+    long long origin = 0;
+    long long positions = 0;    // first to last window, inclusive
+    // Stretches of windows with no position missing: first position and first row
+    std::vector<std::pair<long long, size_t>> segments;
+    // Positive windows, sorted; runs never touch or cross a missing position
+    SparseRuns runs;
+};
+
+// Positive windows as runs per contig, so the algorithms below cost
+// O(runs log runs) rather than O(windows). stride is the greatest common
+// divisor of the steps between consecutive windows of every contig; it is 0
+// when no contig has two windows to measure it from.
+struct SparseTrack {
+    size_t rows = 0;
+    long long stride = 0;
+    std::vector<SparseContig> contigs;
+};
+
+// Splits labels into runs by contig and coordinate. Without coords every
+// row is one position of stride 1. Throws std::invalid_argument when the
+// coordinates of a contig do not increase.
+SparseTrack buildSparseTrack(const BitLabels& labels, const std::vector<ContigRange>& contigs,
+                             const std::vector<long long>& coords);
+BitLabels denseLabels(const SparseTrack& track);
+
+// Runs mwa, median, rle, ccl or dbscan on every contig. Lengths in bp (see
+// Algorithm::basePairs) are converted with the track's stride: distances
+// (ccl gap, dbscan eps) round down, minimum sizes round up, and an mwa or
+// median window must be a whole number of windows. On a track with no missing
+// positions and lengths in windows, the output equals the dense algorithm's.
+SparseTrack clusterSparse(const Algorithm& algorithm, const SparseTrack& track, int numThreads);
+
+// The pipeline on the sparse form of track, which needs track.coords when
+// a length is in bp. runPipelineByContig comes here when usesBasePairs(pipeline).
+BitLabels runSparsePipeline(const Pipeline& pipeline, const LabelTrack& track, int numThreads);
@@ -0,0 +1,203 @@
+// stream.cpp
+
+#include "prophage_signal_processor.h"
+#include "stream_filter.h"
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+// Splits a byte stream into lines, reading a fixed-size block at a time.
+// Lines are passed without their '\n'; a trailing line without one is passed at the end.
+class LineReader {
+public:
+    explicit LineReader(std::FILE* file) : file_(file), buffer_(1 << 16) {}
+
+    // Reads one block and calls fn(begin, end) for every complete line in it.
+    // Returns false once the input is exhausted.
+    template <typename Fn>
+    bool readBlock(Fn&& fn) {
+        if (used_ == buffer_.size()) buffer_.resize(buffer_.size() * 2);  // a line longer than the buffer
+        size_t got = std::fread(buffer_.data() + used_, 1, buffer_.size() - used_, file_);
+        if (got == 0) {
+            if (std::ferror(file_)) throw std::runtime_error("Read error on input stream");
+            if (used_ > 0) fn(buffer_.data(), buffer_.data() + used_);
+            used_ = 0;
+            return false;
+        }
+        used_ += got;
+
+        const char* p = buffer_.data();
+        const char* end = p + used_;
+        while (const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p))) {
+            fn(p, newline);
+            p = newline + 1;
+        }
+        used_ = static_cast<size_t>(end - p);
+        std::memmove(buffer_.data(), p, used_);
+        return true;
+    }
+
+private:
+    std::FILE* file_;
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+};
+
+static void printStreamUsage(const std::string& program) {
+    std::cerr << "Usage: " << program << " stream <input_file|-> <output_file|-> <algorithm> [parameters]\n";
+    std::cerr << "The algorithm may also be a pipeline spec such as median:5|ccl:40:8.\n";
+    std::cerr << "Use - to read rows from stdin or write labels to stdout.\n";
+}
+
+int runStream(const std::vector<std::string>& args, const std::string& labelColumn, const std::string& truthColumn,
+              const std::string& contigColumn) {
+    if (args.size() < 5) {
+        printStreamUsage(args[0]);
+        return 1;
+    }
+    const std::string& inputFile = args[2];
+    const std::string& outputFile = args[3];
+
+    Pipeline pipeline;
+    try {
+        pipeline = parseAlgorithmArguments(args, 4);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    // Labels go to stdout when it is the output, so the report moves to stderr
+    std::ostream& report = (outputFile == "-") ? std::cerr : std::cout;
+
+    std::FILE* in = (inputFile == "-") ? stdin : std::fopen(inputFile.c_str(), "rb");
+    std::FILE* out = (outputFile == "-") ? stdout : std::fopen(outputFile.c_str(), "wb");
+    if (!in || !out) {
+        std::cerr << "Error: Could not open " << (!in ? inputFile : outputFile) << "\n";
+        if (in && in != stdin) std::fclose(in);
+        if (out && out != stdout) std::fclose(out);
+        return 1;
+    }
+
+    // Rows read but not yet emitted, as label | truth << 1. The filter's lag
+    // bounds its length, so memory does not grow with the input.
+    std::deque<uint8_t> waiting;
+    size_t maxWaiting = 0;
+    long long before[4] = {0, 0, 0, 0};  // indexed by truth * 2 + label
+    long long after[4] = {0, 0, 0, 0};
+    std::string output = "label\n";
+
+    int status = 0;
+    try {
+        auto emit = [&](bool label) {
+            uint8_t row = waiting.front();
+            waiting.pop_front();
+            int truth = row >> 1;
+            ++before[truth * 2 + (row & 1)];
+            ++after[truth * 2 + label];
+            output += label ? '1' : '0';
+            output += '\n';
+        };
+        auto filter = makeStreamFilter(pipeline, emit);
+
+        // Each contig runs through a fresh filter, so no cluster crosses a
+        // change in the contig column; the finished filter emits its tail first
+        std::string contig;
+        long long windows = 0, contigs = 0;
+        auto startContig = [&](const char* begin, const char* end) {
+            if (contigs > 0 && contig.compare(0, std::string::npos, begin, end - begin) == 0) return;
+            if (contigs++ > 0) {
+                filter->finish();
+                windows += filter->pushed();
+                filter = makeStreamFilter(pipeline, emit);
+            }
+            contig.assign(begin, end);
+        };
+
+        int labelIndex = -1, truthIndex = -1, contigIndex = -1, lastIndex = -1;
+        size_t lineNumber = 0;
+        auto parseLine = [&](const char* p, const char* lineEnd) {
+            ++lineNumber;
+            if (lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+            if (lineNumber == 1) {
+                labelIndex = findColumn(p, lineEnd, labelColumn);
+                truthIndex = findColumn(p, lineEnd, truthColumn);
+                if (labelIndex < 0) {
+                    throw std::runtime_error("Column '" + labelColumn + "' not found in " + inputFile);
+                }
+                if (!contigColumn.empty()) {
+                    contigIndex = findColumn(p, lineEnd, contigColumn);
+                    if (contigIndex < 0) {
+                        throw std::runtime_error("Column '" + contigColumn + "' not found in " + inputFile);
+                    }
+                }
+                lastIndex = std::max({labelIndex, truthIndex, contigIndex});
+                return;
+            }
+            if (lineEnd == p) return;
+
+            int values[2] = {0, 0};
+            const char* field = p;
+            for (int i = 0; i <= lastIndex; ++i) {
+                if (field > lineEnd) {
+                    throw std::runtime_error(inputFile + ":" + std::to_string(lineNumber) + ": missing column");
+                }
+                if (i == labelIndex || i == truthIndex) {
+                    auto result = std::from_chars(field, lineEnd, values[i == labelIndex ? 0 : 1]);
+                    if (result.ec != std::errc() || (result.ptr != lineEnd && *result.ptr != ',')) {
+                        throw std::runtime_error(inputFile + ":" + std::to_string(lineNumber) + ": invalid integer");
+                    }
+                }
+                if (i < lastIndex || i == contigIndex) {
+                    const char* comma = static_cast<const char*>(std::memchr(field, ',', lineEnd - field));
+                    if (i == contigIndex) startContig(field, comma ? comma : lineEnd);
+                    field = comma ? comma + 1 : lineEnd + 1;
+                }
+            }
+            if ((values[0] | values[1]) & ~1) {
+                throw std::runtime_error(inputFile + ":" + std::to_string(lineNumber) + ": labels must be 0 or 1");
+            }
+            waiting.push_back(static_cast<uint8_t>(values[0] | values[1] << 1));
+            maxWaiting = std::max(maxWaiting, waiting.size());
+            filter->push(values[0] == 1);
+        };
+
+        // Finished labels are written after every block, so a slow producer
+        // sees its output without waiting for a full buffer
+        LineReader reader(in);
+        bool more = true;
+        while (more) {
+            more = reader.readBlock(parseLine);
+            if (!more) filter->finish();
+            std::fwrite(output.data(), 1, output.size(), out);
+            std::fflush(out);
+            output.clear();
+        }
+        if (lineNumber == 0) {
+            throw std::runtime_error("Empty input: " + inputFile);
+        }
+
+        windows += filter->pushed();
+        report << "Streamed " << windows << " windows through " << pipelineSpec(pipeline);
+        if (contigIndex >= 0) report << " in " << contigs << " contigs";
+        report << ", holding at most " << maxWaiting << " rows\n";
+        if (outputFile != "-") report << "Output written to " << outputFile << "\n";
+        if (truthIndex < 0) {
+            report << "No truth labels available, skipping metrics." << std::endl;
+        } else {
+            report << "Metrics before clustering:" << std::endl;
+            printMetrics(metricsFromCounts(before[3], before[1], before[0], before[2]), report);
+            report << "\nMetrics after clustering:" << std::endl;
+            printMetrics(metricsFromCounts(after[3], after[1], after[0], after[2]), report);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        status = 1;
+    }
+
+    if (in != stdin) std::fclose(in);
+    if (out != stdout && std::fclose(out) != 0) status = 1;
+    return status;
+}
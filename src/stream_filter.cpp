@@ -0,0 +1,48 @@
+// stream_filter.cpp
+
+#include "stream_filter.h"
+
+std::unique_ptr<StreamFilter> makeStreamFilter(const AlgorithmConfig& config, StreamFilter::Emit emit) {
+    Algorithm algorithm = config.algorithm();
+    if (algorithm.basePairs) {
+        throw std::invalid_argument(config.spec() + ": lengths in bp need window coordinates, which a stream does not keep.");
+    }
+    switch (algorithm.type) {
+        case ALGORITHM_MWA:
+            return std::make_unique<MovingWindowAverageStream>(algorithm.windowSize, algorithm.threshold, std::move(emit));
+        case ALGORITHM_PMWA:
+            return std::make_unique<ProbabilityWindowAverageStream>(algorithm.windowSize, algorithm.threshold, std::move(emit));
+        case ALGORITHM_RLE:
+            return std::make_unique<RunLengthEncodingStream>(algorithm.minSize, std::move(emit));
+        case ALGORITHM_DBSCAN:
+            return std::make_unique<DbscanStream>(algorithm.eps, algorithm.minPts, std::move(emit));
+        case ALGORITHM_MEDIAN:
+            return std::make_unique<MedianFilterStream>(algorithm.windowSize, std::move(emit));
+        case ALGORITHM_HMM:
+            throw std::invalid_argument("hmm traces back over the whole contig, so it cannot run as a stream.");
+        case ALGORITHM_CCL:
+        default:
+            return std::make_unique<ConnectedComponentStream>(algorithm.minSize, algorithm.gapTolerance, std::move(emit));
+    }
+}
+
+std::unique_ptr<StreamFilter> makeStreamFilter(const Pipeline& pipeline, StreamFilter::Emit emit) {
+    if (pipeline.empty()) {
+        throw std::invalid_argument("Empty pipeline.");
+    }
+    if (pipeline.size() == 1) return makeStreamFilter(pipeline[0], std::move(emit));
+    return std::make_unique<PipelineFilter>(pipeline, std::move(emit));
+}
+
+PipelineFilter::PipelineFilter(const Pipeline& pipeline, Emit emit)
+    : StreamFilter(std::move(emit)), tiles_(std::max<size_t>(pipeline.size(), 2)) {
+    for (size_t s = 0; s < pipeline.size(); ++s) {
+        if (s + 1 == pipeline.size()) {
+            stages_.push_back(makeStreamFilter(pipeline[s], [this](bool value) { this->emit(value); }));
+        } else {
+            std::vector<uint8_t>& next = tiles_[s + 1];
+            next.reserve(PIPELINE_TILE);
+            stages_.push_back(makeStreamFilter(pipeline[s], [&next](bool value) { next.push_back(value); }));
+        }
+    }
+}
@@ -0,0 +1,383 @@
+// stream_filter.h
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "prophage_signal_processor.h"
+
+// Incremental forms of the bit-label algorithms. Labels are pushed one window
+// at a time and each output label is passed to the emit callback, in order,
+// as soon as no later input can change it. finish() emits the remaining tail.
+// The concatenated output equals the batch algorithm on the whole input.
+//
+// State is a ring over the last window of input plus the labels whose fate is
+// still open: at most windowSize for mwa and median, minLength for rle and
+// minSize for ccl. dbscan holds a chain of 1s until one of its members is
+// found to be a core point, so its state is bounded by the longest chain
+// without one.
+class StreamFilter {
+public:
+    using Emit = std::function<void(bool)>;
+
+    explicit StreamFilter(Emit emit) : emit_(std::move(emit)) {}
+    virtual ~StreamFilter() = default;
+
+    virtual void push(bool value) = 0;
+    virtual void finish() = 0;
+
+    // Feeds a prob_1 score. Label filters see score >= threshold; filters
+    // that cluster on the scores themselves override this.
+    virtual void pushProbability(double probability, double threshold) { push(probability >= threshold); }
+
+    long long pushed() const { return pushed_; }
+    long long emitted() const { return emitted_; }
+
+protected:
+    void emit(bool value) {
+        ++emitted_;
+        emit_(value);
+    }
+    void emit(bool value, long long count) {
+        for (long long i = 0; i < count; ++i) emit(value);
+    }
+
+    long long pushed_ = 0;
+
+private:
+    Emit emit_;
+    long long emitted_ = 0;
+};
+
+// The last capacity values pushed, initially all 0
+class BitRing {
+public:
+    explicit BitRing(size_t capacity) : values_(capacity, 0) {}
+
+    // Stores value and returns the one it replaces
+    bool push(bool value) {
+        bool oldest = values_[next_];
+        values_[next_] = value;
+        if (++next_ == values_.size()) next_ = 0;
+        return oldest;
+    }
+
+    // Value pushed age pushes ago; 0 is the newest
+    bool at(size_t age) const {
+        size_t i = next_ + values_.size() - 1 - age;
+        return values_[i >= values_.size() ? i - values_.size() : i];
+    }
+
+private:
+    std::vector<uint8_t> values_;
+    size_t next_ = 0;
+};
+
+// The window ending at each input is decided on arrival and written windowSize / 2 back
+class MovingWindowAverageStream : public StreamFilter {
+public:
+    MovingWindowAverageStream(int windowSize, double threshold, Emit emit)
+        : StreamFilter(std::move(emit)), windowSize_(windowSize), half_(windowSize / 2),
+          minSum_(minimumWindowSum(windowSize, threshold)), window_(std::max(windowSize, 1)) {
+        if (windowSize < 1) {
+            throw std::invalid_argument("Moving Window Average requires a positive window size.");
+        }
+    }
+
+    void push(bool value) override {
+        sum_ += static_cast<int>(value) - static_cast<int>(window_.push(value));
+        ++pushed_;
+        if (pushed_ >= windowSize_) emit(sum_ >= minSum_);
+        else if (pushed_ <= windowSize_ - 1 - half_) emit(false);
+    }
+
+    void finish() override { emit(false, pushed_ - emitted()); }
+
+private:
+    long long windowSize_, half_;
+    int minSum_;
+    int sum_ = 0;
+    BitRing window_;
+};
+
+// Moving window average of prob_1 scores rather than 0/1 labels: the window
+// ending at each score is written windowSize / 2 back when its mean reaches
+// threshold. The running sum is rebuilt from the ring once per window so
+// rounding error cannot accumulate along a genome.
+class ProbabilityWindowAverageStream : public StreamFilter {
+public:
+    ProbabilityWindowAverageStream(int windowSize, double threshold, Emit emit)
+        : StreamFilter(std::move(emit)), windowSize_(windowSize), half_(windowSize / 2),
+          threshold_(threshold), window_(std::max(windowSize, 1), 0.0) {
+        if (windowSize < 1) {
+            throw std::invalid_argument("Probability-weighted MWA requires a positive window size.");
+        }
+    }
+
+    void push(bool value) override { pushProbability(value ? 1.0 : 0.0, threshold_); }
+
+    void pushProbability(double score, double) override {
+        sum_ += score - window_[next_];
+        window_[next_] = score;
+        if (++next_ == window_.size()) {
+            next_ = 0;
+            sum_ = 0;
+            for (double value : window_) sum_ += value;
+        }
+        ++pushed_;
+        if (pushed_ >= windowSize_) emit(sum_ / windowSize_ >= threshold_);
+        else if (pushed_ <= windowSize_ - 1 - half_) emit(false);
+    }
+
+    void finish() override { emit(false, pushed_ - emitted()); }
+
+private:
+    long long windowSize_, half_;
+    double threshold_;
+    std::vector<double> window_;
+    size_t next_ = 0;
+    double sum_ = 0;
+};
+
+// Zero-padded centred window; the ring starts as the left padding and
+// finish() slides it over the right padding.
+class MedianFilterStream : public StreamFilter {
+public:
+    MedianFilterStream(int windowSize, Emit emit)
+        : StreamFilter(std::move(emit)), lag_(windowSize - 1 - windowSize / 2),
+          minCount_(windowSize - windowSize / 2), window_(std::max(windowSize, 1)) {
+        if (windowSize < 1) {
+            throw std::invalid_argument("Median Filter requires a positive window size.");
+        }
+    }
+
+    void push(bool value) override {
+        ++pushed_;
+        step(value);
+    }
+
+    void finish() override {
+        while (emitted() < pushed_) step(false);
+    }
+
+private:
+    void step(bool value) {
+        sum_ += static_cast<int>(value) - static_cast<int>(window_.push(value));
+        if (++steps_ > lag_) emit(sum_ >= minCount_);
+    }
+
+    long long lag_;
+    int minCount_;
+    int sum_ = 0;
+    long long steps_ = 0;
+    BitRing window_;
+};
+
+// A run is held until it reaches minLength (kept) or ends short (dropped)
+class RunLengthEncodingStream : public StreamFilter {
+public:
+    RunLengthEncodingStream(int minLength, Emit emit) : StreamFilter(std::move(emit)), minLength_(minLength) {}
+
+    void push(bool value) override {
+        ++pushed_;
+        if (!value) {
+            emit(false, pending_);
+            pending_ = 0;
+            kept_ = false;
+            emit(false);
+        } else if (kept_) {
+            emit(true);
+        } else if (++pending_ >= minLength_) {
+            emit(true, pending_);
+            pending_ = 0;
+            kept_ = true;
+        }
+    }
+
+    void finish() override {
+        emit(false, pending_);
+        pending_ = 0;
+    }
+
+private:
+    long long minLength_;
+    long long pending_ = 0;
+    bool kept_ = false;
+};
+
+// Membership is known on arrival: a 0 belongs to the open component while it
+// is within gapTolerance of the last 1. Members are held until the component
+// reaches minSize.
+class ConnectedComponentStream : public StreamFilter {
+public:
+    ConnectedComponentStream(int minSize, int gapTolerance, Emit emit)
+        : StreamFilter(std::move(emit)), minSize_(minSize), gap_(std::max(0, gapTolerance)) {}
+
+    void push(bool value) override {
+        ++pushed_;
+        if (value) {
+            if (!open_) {
+                open_ = true;
+                kept_ = false;
+                size_ = 0;
+            }
+            zeros_ = 0;
+            member();
+        } else if (open_ && zeros_ < gap_) {
+            ++zeros_;
+            member();
+        } else {
+            close();
+            emit(false);
+        }
+    }
+
+    void finish() override { close(); }
+
+private:
+    void member() {
+        ++size_;
+        if (kept_) {
+            emit(true);
+            return;
+        }
+        ++pending_;
+        if (size_ >= minSize_) {
+            emit(true, pending_);
+            pending_ = 0;
+            kept_ = true;
+        }
+    }
+
+    void close() {
+        emit(false, pending_);
+        pending_ = 0;
+        open_ = false;
+    }
+
+    long long minSize_, gap_;
+    long long size_ = 0, zeros_ = 0, pending_ = 0;
+    bool open_ = false, kept_ = false;
+};
+
+// The core test for position p is made when p + eps arrives, from a ring over
+// [p - eps, p + eps]. A chain closes once the next 1 is more than eps away,
+// by which time every member has been tested.
+class DbscanStream : public StreamFilter {
+public:
+    DbscanStream(int eps, int minPts, Emit emit)
+        : StreamFilter(std::move(emit)), eps_(eps), minPts_(minPts),
+          window_(eps > 0 ? 2 * static_cast<size_t>(eps) + 1 : 1) {}
+
+    void push(bool value) override {
+        long long pos = pushed_++;
+        if (eps_ <= 0) {
+            // Every 1 is its own chain and its neighbourhood is itself (eps 0) or empty
+            emit(value && (eps_ == 0 ? 1 : 0) >= minPts_);
+            return;
+        }
+        step(value, pos);
+        if (value) {
+            if (!open_) {
+                open_ = true;
+                kept_ = false;
+                chainStart_ = pos;
+            }
+            lastOne_ = pos;
+        }
+        if (open_ && !kept_) pending_.push_back(value);
+        else emit(value);
+    }
+
+    void finish() override {
+        if (eps_ > 0) {
+            // Slide the ring over the zero padding so the last eps positions are tested
+            for (long long k = 0; k < eps_; ++k) step(false, pushed_ + k);
+        }
+        close();
+    }
+
+private:
+    void step(bool value, long long pos) {
+        count_ += static_cast<int>(value) - static_cast<int>(window_.push(value));
+        long long p = pos - eps_;
+        if (open_ && !kept_ && p >= chainStart_ && window_.at(eps_) && count_ >= minPts_) {
+            for (bool pendingValue : pending_) emit(pendingValue);
+            pending_.clear();
+            kept_ = true;
+        }
+        if (open_ && pos - lastOne_ > eps_) close();
+    }
+
+    void close() {
+        if (open_ && !kept_) emit(false, static_cast<long long>(pending_.size()));
+        pending_.clear();
+        open_ = false;
+    }
+
+    long long eps_;
+    int minPts_;
+    BitRing window_;
+    int count_ = 0;
+    std::vector<bool> pending_;
+    long long chainStart_ = 0, lastOne_ = 0;
+    bool open_ = false, kept_ = false;
+};
+
+// Windows a pipeline stage collects before handing them to the next stage
+constexpr size_t PIPELINE_TILE = 4096;
+
+// Stages chained so each consumes the previous one's output. Labels between
+// stages are buffered a tile at a time and every later stage runs over a
+// whole tile before the next one is collected, so each stage's state and
+// the tiles stay in cache. The first stage sees the input directly, which
+// lets it take prob_1 scores. Output equals applying the stages one after
+// another to the whole input.
+class PipelineFilter : public StreamFilter {
+public:
+    PipelineFilter(const Pipeline& pipeline, Emit emit);
+
+    void push(bool value) override {
+        ++pushed_;
+        stages_[0]->push(value);
+        if (tiles_[1].size() >= PIPELINE_TILE) drain();
+    }
+
+    void pushProbability(double probability, double threshold) override {
+        ++pushed_;
+        stages_[0]->pushProbability(probability, threshold);
+        if (tiles_[1].size() >= PIPELINE_TILE) drain();
+    }
+
+    void finish() override {
+        stages_[0]->finish();
+        for (size_t s = 1; s < stages_.size(); ++s) {
+            feed(s);
+            stages_[s]->finish();
+        }
+    }
+
+private:
+    // Runs each later stage over the tile waiting for it
+    void drain() {
+        for (size_t s = 1; s < stages_.size(); ++s) feed(s);
+    }
+
+    void feed(size_t s) {
+        for (uint8_t value : tiles_[s]) stages_[s]->push(value);
+        tiles_[s].clear();
+    }
+
+    std::vector<std::unique_ptr<StreamFilter>> stages_;
+    // tiles_[s] holds stage s - 1's output not yet pushed into stage s
+    std::vector<std::vector<uint8_t>> tiles_;
+};
+
+// Streaming filter for a configuration accepted by runAlgorithm
+std::unique_ptr<StreamFilter> makeStreamFilter(const AlgorithmConfig& config, StreamFilter::Emit emit);
+// A single stage gives its plain filter, longer pipelines a PipelineFilter
+std::unique_ptr<StreamFilter> makeStreamFilter(const Pipeline& pipeline, StreamFilter::Emit emit);
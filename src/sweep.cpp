@@ -0,0 +1,392 @@
+// sweep.cpp
+
+#include "prophage_signal_processor.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include "result_cache.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+// Expands one grid axis: "70", "0.1,0.2,0.5" or "10-100/10" (step defaults
+// to 1). Values are formatted and re-parsed so every grid point uses exactly
+// the parameter its spec string shows.
+static std::vector<std::string> expandAxis(const std::string& axis) {
+    std::vector<std::string> values;
+    if (axis.find(',') != std::string::npos) {
+        std::istringstream iss(axis);
+        std::string value;
+        while (std::getline(iss, value, ',')) values.push_back(value);
+        return values;
+    }
+
+    size_t dash = axis.find('-', 1);
+    if (dash == std::string::npos) return {axis};
+
+    size_t slash = axis.find('/', dash);
+    std::string lo = axis.substr(0, dash);
+    std::string hi = axis.substr(dash + 1, slash == std::string::npos ? std::string::npos : slash - dash - 1);
+    std::string step = (slash == std::string::npos) ? "1" : axis.substr(slash + 1);
+
+    bool integral = (axis.find('.') == std::string::npos);
+    double start = std::stod(lo), stop = std::stod(hi), increment = std::stod(step);
+    if (increment <= 0) {
+        throw std::invalid_argument("Grid step must be positive: " + axis);
+    }
+    for (long k = 0; start + k * increment <= stop + increment * 1e-9; ++k) {
+        std::ostringstream oss;
+        if (integral) oss << static_cast<long>(start) + k * static_cast<long>(increment);
+        else oss << start + k * increment;
+        values.push_back(oss.str());
+    }
+    return values;
+}
+
+// Structures shared by every grid point of one genome. The labels stay
+// bit-packed, and counts over any range are two rank lookups on per-word
+// popcount prefixes, so the track costs about two bits per window plus its runs.
+// Runs never cross a contig boundary, and the algorithms below work contig by
+// contig, as runAlgorithmByContig does in batch mode.
+struct SweepTrack {
+    BitLabels input, truth;
+    BitRank inputRank, truthRank;
+    std::vector<ContigRange> contigs;
+    std::vector<std::pair<size_t, size_t>> runs;  // [start, end) runs of predicted 1s
+    std::vector<size_t> contigRuns;  // runs of contig c are [contigRuns[c], contigRuns[c + 1])
+    long long positives = 0;
+    long long negatives = 0;
+
+    // Runs are found by count-trailing-zeros scans over the words
+    explicit SweepTrack(LabelTrack track)
+        : input(std::move(track.labels)), truth(std::move(track.trueLabels)), inputRank(input), truthRank(truth),
+          contigs(std::move(track.contigs)) {
+        for (const auto& contig : contigs) {
+            contigRuns.push_back(runs.size());
+            for (size_t start = input.findNextOne(contig.begin); start < contig.end;) {
+                size_t end = std::min(input.findNextZero(start), contig.end);
+                runs.emplace_back(start, end);
+                start = input.findNextOne(end);
+            }
+        }
+        contigRuns.push_back(runs.size());
+        positives = static_cast<long long>(truth.count());
+        negatives = static_cast<long long>(input.size()) - positives;
+    }
+    // The ranks refer to the labels above
+    SweepTrack(const SweepTrack&) = delete;
+    SweepTrack& operator=(const SweepTrack&) = delete;
+
+    long long truthIn(size_t start, size_t end) const {
+        return static_cast<long long>(truthRank.count(static_cast<long long>(start), static_cast<long long>(end)));
+    }
+};
+
+// Regions that a threshold-like parameter switches on, sorted by the value the
+// parameter is compared against. Suffix sums give the confusion counts for any
+// threshold with one binary search.
+struct ThresholdTable {
+    std::vector<long long> keys;
+    std::vector<long long> truthSuffix;
+    std::vector<long long> sizeSuffix;
+
+    // regions are (key, size, true positives inside)
+    void build(std::vector<std::tuple<long long, long long, long long>> regions) {
+        std::sort(regions.begin(), regions.end());
+        keys.resize(regions.size());
+        truthSuffix.assign(regions.size() + 1, 0);
+        sizeSuffix.assign(regions.size() + 1, 0);
+        for (size_t i = regions.size(); i-- > 0;) {
+            keys[i] = std::get<0>(regions[i]);
+            sizeSuffix[i] = sizeSuffix[i + 1] + std::get<1>(regions[i]);
+            truthSuffix[i] = truthSuffix[i + 1] + std::get<2>(regions[i]);
+        }
+    }
+
+    // Counts for the regions whose key is >= minKey
+    Metrics countsAtLeast(long long minKey, const SweepTrack& track) const {
+        size_t i = std::lower_bound(keys.begin(), keys.end(), minKey) - keys.begin();
+        long long tp = truthSuffix[i];
+        long long fp = sizeSuffix[i] - tp;
+        return metricsFromCounts(tp, fp, track.negatives - fp, track.positives - tp);
+    }
+};
+
+struct SweepRow {
+    std::string spec;
+    Metrics metrics;
+};
+
+// Spec of each grid point, as in the output and the cache keys
+static std::string mwaSpec(int windowSize, const std::string& threshold) {
+    return "mwa:" + std::to_string(windowSize) + ":" + threshold;
+}
+
+static std::string rleSpec(const std::string& minLength) {
+    return "rle:" + minLength;
+}
+
+static std::string cclSpec(const std::string& minSize, int gapTolerance) {
+    return "ccl:" + minSize + ":" + std::to_string(gapTolerance);
+}
+
+// mwa:<window>:<threshold>. For one window the centred sums are bucketed by
+// value, so every threshold is a suffix lookup over the buckets.
+static void sweepMWA(const SweepTrack& track, int windowSize, const std::vector<std::string>& thresholds,
+                     std::vector<SweepRow>& rows) {
+    std::vector<long long> truthAt(windowSize + 2, 0), countAt(windowSize + 2, 0);
+    for (const auto& contig : track.contigs) {
+        long long begin = static_cast<long long>(contig.begin), end = static_cast<long long>(contig.end);
+        for (long long i = begin + windowSize - 1; i < end; ++i) {
+            size_t sum = track.inputRank.count(i + 1 - windowSize, i + 1);
+            size_t center = static_cast<size_t>(i - windowSize / 2);
+            countAt[sum]++;
+            truthAt[sum] += track.truth.get(center);
+        }
+    }
+    for (int k = windowSize; k >= 0; --k) {
+        countAt[k] += countAt[k + 1];
+        truthAt[k] += truthAt[k + 1];
+    }
+
+    for (const auto& value : thresholds) {
+        int minSum = minimumWindowSum(windowSize, std::stod(value));
+
+        long long tp = truthAt[minSum];
+        long long fp = countAt[minSum] - tp;
+        rows.push_back({mwaSpec(windowSize, value), metricsFromCounts(tp, fp, track.negatives - fp, track.positives - tp)});
+    }
+}
+
+// rle:<min_length>. Every run is kept or dropped by its length alone.
+static void sweepRLE(const SweepTrack& track, const std::vector<std::string>& minLengths, std::vector<SweepRow>& rows) {
+    std::vector<std::tuple<long long, long long, long long>> regions;
+    for (const auto& run : track.runs) {
+        long long length = static_cast<long long>(run.second - run.first);
+        regions.emplace_back(length, length, track.truthIn(run.first, run.second));
+    }
+    ThresholdTable table;
+    table.build(std::move(regions));
+
+    for (const auto& value : minLengths) {
+        rows.push_back({rleSpec(value), table.countsAtLeast(std::stoi(value), track)});
+    }
+}
+
+// ccl:<min_size>:<gap>. For one gap tolerance the runs are merged into
+// components once; each component spans from its first run to gapTolerance
+// windows past its last run, cut at the contig end, as connectedComponentLabeling does.
+static void sweepCCL(const SweepTrack& track, int gapTolerance, const std::vector<std::string>& minSizes,
+                     std::vector<SweepRow>& rows) {
+    size_t gap = static_cast<size_t>(gapTolerance);
+    std::vector<std::tuple<long long, long long, long long>> regions;
+    for (size_t c = 0; c < track.contigs.size(); ++c) {
+        size_t contigEnd = track.contigs[c].end, runsEnd = track.contigRuns[c + 1];
+        for (size_t r = track.contigRuns[c]; r < runsEnd;) {
+            size_t start = track.runs[r].first;
+            size_t last = track.runs[r].second;
+            for (++r; r < runsEnd && track.runs[r].first - last <= gap; ++r) {
+                last = track.runs[r].second;
+            }
+            size_t end = std::min(last + gap, contigEnd);
+            long long size = static_cast<long long>(end - start);
+            regions.emplace_back(size, size, track.truthIn(start, end));
+        }
+    }
+    ThresholdTable table;
+    table.build(std::move(regions));
+
+    for (const auto& value : minSizes) {
+        rows.push_back({cclSpec(value, gapTolerance), table.countsAtLeast(std::stoll(value), track)});
+    }
+}
+
+int runSweep(const std::vector<std::string>& args, const std::string& labelColumn, const std::string& truthColumn,
+             const std::string& contigColumn) {
+    std::vector<std::string> positional;
+    int numThreads = static_cast<int>(ThreadPool::shared().concurrency());
+    std::string cacheDir;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (args[i] == "--threads" && i + 1 < args.size()) numThreads = std::stoi(args[++i]);
+        else if (args[i] == "--cache" && i + 1 < args.size()) cacheDir = args[++i];
+        else positional.push_back(args[i]);
+    }
+    if (positional.size() < 3) {
+        std::cerr << "Usage: " << args[0] << " sweep <input_dir|manifest|file> <output_csv> <grid ...> [--threads N] [--cache dir]\n";
+        std::cerr << "Grids: mwa:<windows>:<thresholds> rle:<min_lengths> ccl:<min_sizes>:<gaps>\n";
+        return 1;
+    }
+
+    // Each grid becomes its algorithm plus the expanded values of each axis
+    struct Grid {
+        std::string name;
+        std::vector<std::vector<std::string>> axes;
+    };
+    std::vector<std::string> files;
+    std::vector<Grid> grids;
+    std::unique_ptr<ResultCache> cache;
+    try {
+        if (!cacheDir.empty()) cache = std::make_unique<ResultCache>(cacheDir);
+        files = collectInputFiles(positional[0]);
+        for (size_t i = 2; i < positional.size(); ++i) {
+            std::istringstream iss(positional[i]);
+            Grid grid;
+            std::getline(iss, grid.name, ':');
+            std::string axis;
+            while (std::getline(iss, axis, ':')) {
+                if (axis.find("bp") != std::string::npos) {
+                    throw std::invalid_argument("Sweep grids are in windows; lengths in bp run in batch or single-file mode: " + positional[i]);
+                }
+                grid.axes.push_back(expandAxis(axis));
+            }
+
+            size_t expected = (grid.name == "rle") ? 1 : 2;
+            if (grid.name != "mwa" && grid.name != "rle" && grid.name != "ccl") {
+                throw std::invalid_argument("Sweep supports mwa, rle and ccl, not: " + grid.name);
+            }
+            if (grid.axes.size() != expected) {
+                throw std::invalid_argument("Grid '" + grid.name + "' takes " + std::to_string(expected) + " axes: " + positional[i]);
+            }
+            auto requireAtLeast = [&](const std::vector<std::string>& values, int minimum, const char* what) {
+                for (const auto& value : values) {
+                    if (std::stoi(value) < minimum) {
+                        throw std::invalid_argument(grid.name + " " + what + " must be at least " + std::to_string(minimum));
+                    }
+                }
+            };
+            if (grid.name == "mwa") requireAtLeast(grid.axes[0], 1, "window_size");
+            if (grid.name == "rle") requireAtLeast(grid.axes[0], 1, "min_length");
+            if (grid.name == "ccl") requireAtLeast(grid.axes[1], 0, "gap tolerance");
+            grids.push_back(std::move(grid));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::ofstream out(positional[1]);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open output file: " << positional[1] << "\n";
+        return 1;
+    }
+    out << "Filename,Algorithm,TP,FP,TN,FN,Accuracy,Precision,Recall,F1_Score,MCC\n";
+    auto writeRow = [&](const std::string& filename, const SweepRow& row) {
+        const Metrics& m = row.metrics;
+        out << filename << "," << row.spec << "," << m.tp << "," << m.fp << "," << m.tn << "," << m.fn << ","
+            << m.accuracy << "," << m.precision << "," << m.recall << "," << m.f1 << "," << m.mcc << "\n";
+    };
+
+    // One task per shared structure: an MWA window, the RLE run table, or a
+    // CCL gap. specs lists the grid points the task writes, in order.
+    struct SweepTask {
+        std::vector<std::string> specs;
+        std::function<void(const SweepTrack&, std::vector<SweepRow>&)> run;
+    };
+    std::vector<SweepTask> tasks;
+    for (const auto& grid : grids) {
+        if (grid.name == "mwa") {
+            for (const auto& window : grid.axes[0]) {
+                int windowSize = std::stoi(window);
+                SweepTask task;
+                for (const auto& value : grid.axes[1]) task.specs.push_back(mwaSpec(windowSize, value));
+                task.run = [&grid, windowSize](const SweepTrack& track, std::vector<SweepRow>& rows) {
+                    sweepMWA(track, windowSize, grid.axes[1], rows);
+                };
+                tasks.push_back(std::move(task));
+            }
+        } else if (grid.name == "rle") {
+            SweepTask task;
+            for (const auto& value : grid.axes[0]) task.specs.push_back(rleSpec(value));
+            task.run = [&grid](const SweepTrack& track, std::vector<SweepRow>& rows) { sweepRLE(track, grid.axes[0], rows); };
+            tasks.push_back(std::move(task));
+        } else {
+            for (const auto& gap : grid.axes[1]) {
+                int gapTolerance = std::stoi(gap);
+                SweepTask task;
+                for (const auto& value : grid.axes[0]) task.specs.push_back(cclSpec(value, gapTolerance));
+                task.run = [&grid, gapTolerance](const SweepTrack& track, std::vector<SweepRow>& rows) {
+                    sweepCCL(track, gapTolerance, grid.axes[0], rows);
+                };
+                tasks.push_back(std::move(task));
+            }
+        }
+    }
+    std::string cacheContext = "sweep;label=" + labelColumn + ";truth=" + truthColumn + ";contig=" + contigColumn;
+
+    // Confusion counts summed over all genomes, keyed by row position
+    std::vector<SweepRow> pooled;
+    size_t processed = 0;
+    for (const auto& file : files) {
+        std::string filename = fs::path(file).filename().string();
+        std::vector<std::vector<SweepRow>> taskRows(tasks.size());
+        std::vector<size_t> missing;
+        try {
+            // A task is taken from the cache only when all of its grid points are there
+            std::string inputHash;
+            if (cache) inputHash = hashFile(file);
+            for (size_t t = 0; t < tasks.size(); ++t) {
+                for (const auto& spec : tasks[t].specs) {
+                    SweepRow row{spec, Metrics()};
+                    if (!cache || !cache->lookup(ResultCache::key(inputHash, cacheContext, spec), &row.metrics)) {
+                        taskRows[t].clear();
+                        missing.push_back(t);
+                        break;
+                    }
+                    taskRows[t].push_back(row);
+                }
+            }
+
+            if (!missing.empty()) {
+                LabelTrack labels = readLabelTrack(file, labelColumn, truthColumn, contigColumn);
+                if (labels.trueLabels.empty()) {
+                    throw std::runtime_error("no '" + truthColumn + "' column");
+                }
+                SweepTrack track(std::move(labels));
+                ThreadPool::shared().forEachIndex(missing.size(), numThreads, [&](size_t m) {
+                    tasks[missing[m]].run(track, taskRows[missing[m]]);
+                });
+                if (cache) {
+                    for (size_t t : missing) {
+                        for (const auto& row : taskRows[t]) {
+                            cache->store(ResultCache::key(inputHash, cacheContext, row.spec), row.metrics);
+                        }
+                    }
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error processing file " << file << ": " << e.what() << "\n";
+            continue;
+        }
+
+        size_t index = 0;
+        for (const auto& rows : taskRows) {
+            for (const auto& row : rows) {
+                writeRow(filename, row);
+                if (pooled.size() <= index) pooled.push_back({row.spec, Metrics()});
+                Metrics& sum = pooled[index++].metrics;
+                sum = metricsFromCounts(sum.tp + row.metrics.tp, sum.fp + row.metrics.fp,
+                                        sum.tn + row.metrics.tn, sum.fn + row.metrics.fn);
+            }
+        }
+        ++processed;
+        std::cout << "Swept " << filename << ": " << index << " grid points";
+        if (cache) std::cout << " (" << tasks.size() - missing.size() << " of " << tasks.size() << " tasks cached)";
+        std::cout << "\n";
+    }
+
+    // Pooled rows score every grid point on the confusion counts of all genomes together
+    if (processed > 1) {
+        for (const auto& row : pooled) writeRow("ALL", row);
+    }
+
+    if (cache) {
+        cache->recordRun("sweep");
+        std::cout << "Cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    }
+    std::cout << "Sweep complete: " << processed << " of " << files.size() << " files. Results are in " << positional[1] << "\n";
+    return processed == files.size() ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+// tests/mwa_threads.cpp: movingWindowAverage at every thread count against a
+// plain per-window reference. Build and run from src/ (see the README):
+//
+//   g++ -std=c++17 -O3 -pthread -I. tests/mwa_threads.cpp $LIB -o mwa_threads && ./mwa_threads
+
+#include "prophage_signal_processor.h"
+#include <iostream>
+#include <limits>
+#include <random>
+#include "thread_pool.h"
+
+// The window ending at i is written to i - windowSize / 2 when
+// sum / windowSize >= threshold; windows that do not fit leave 0s
+static std::vector<int> reference(const std::vector<int>& input, int windowSize, double threshold) {
+    int n = static_cast<int>(input.size());
+    std::vector<int> output(n, 0);
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += input[i] - (i >= windowSize ? input[i - windowSize] : 0);
+        if (i >= windowSize - 1 && static_cast<double>(sum) / windowSize >= threshold) output[i - windowSize / 2] = 1;
+    }
+    return output;
+}
+
+int main() {
+    std::mt19937_64 rng(12345);
+    int maxThreads = std::max(8, static_cast<int>(ThreadPool::shared().concurrency()));
+
+    // Around one grain (a single chunk) and several grains (a chunk per thread)
+    size_t grain = PARALLEL_GRAIN;
+    std::vector<size_t> sizes = {0, 1, 2, 63, 64, 65, grain - 1, grain, grain + 1, 2 * grain - 1, 2 * grain + 1,
+                                 3 * grain + 17, 8 * grain + 5};
+    std::vector<double> thresholds = {0.0, 1.0, std::numeric_limits<double>::quiet_NaN(), 0.5, 1.0 / 3, 0.7, -0.5, 1.5};
+
+    long long cases = 0, failures = 0;
+    for (size_t n : sizes) {
+        double density = std::uniform_real_distribution<double>(0.05, 0.95)(rng);
+        std::vector<int> input(n);
+        for (auto& value : input) value = std::bernoulli_distribution(density)(rng) ? 1 : 0;
+        BitLabels bits = BitLabels::fromInts(input);
+
+        int size = static_cast<int>(n);
+        std::vector<int> windows = {1, 2, 3, 7, 8, 70, 71, size, size + 1, size + 100};
+        windows.push_back(1 + static_cast<int>(rng() % (n + 1)));
+        for (int windowSize : windows) {
+            if (windowSize < 1) continue;
+            for (double threshold : thresholds) {
+                std::vector<int> expected = reference(input, windowSize, threshold);
+                for (int threads = 1; threads <= maxThreads; ++threads) {
+                    ++cases;
+                    bool ints = movingWindowAverage(input, windowSize, threshold, threads) == expected;
+                    bool packed = movingWindowAverage(bits, windowSize, threshold, threads).toInts() == expected;
+                    if (ints && packed) continue;
+                    if (++failures <= 10) {
+                        std::cout << "FAIL n=" << n << " window=" << windowSize << " threshold=" << threshold
+                                  << " threads=" << threads << (ints ? "" : " std::vector<int>")
+                                  << (packed ? "" : " BitLabels") << "\n";
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << cases << " cases, " << failures << " failures\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// thread_pool.cpp
+
+#include "thread_pool.h"
+#include <atomic>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+static std::atomic<bool> pinThreads(false);
+
+// CPUs this process may run on, which under SLURM or taskset can be fewer
+// than the machine has
+static std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) cpus.push_back(static_cast<int>(cpu));
+    }
+    return cpus;
+}
+
+void ThreadPool::setAffinity(bool pin) {
+    pinThreads = pin;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(allowedCpus().size() - 1, pinThreads);
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t workers, bool pin) {
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i, pin);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+std::vector<double> ThreadPool::workerCpuSeconds() {
+    std::vector<double> seconds;
+#ifdef __linux__
+    for (auto& worker : workers_) {
+        clockid_t clock;
+        struct timespec ts;
+        if (pthread_getcpuclockid(worker.native_handle(), &clock) != 0 || clock_gettime(clock, &ts) != 0) return {};
+        seconds.push_back(ts.tv_sec + ts.tv_nsec * 1e-9);
+    }
+#endif
+    return seconds;
+}
+
+// Runs index with the lock released, then records completion under it
+void ThreadPool::execute(Job& job, size_t index, std::unique_lock<std::mutex>& lock) {
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+        job.run(index);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !job.error) job.error = error;
+    if (++job.done == job.count) finished_.notify_all();
+}
+
+void ThreadPool::run(Job& job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobs_.push_back(&job);
+    wake_.notify_all();
+
+    while (job.next < job.count) execute(job, job.next++, lock);
+    finished_.wait(lock, [&]() { return job.done == job.count; });
+
+    // No worker can reach the job once it leaves the queue, so it may go out of scope
+    jobs_.erase(std::find(jobs_.begin(), jobs_.end(), &job));
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+void ThreadPool::workerLoop(size_t worker, bool pin) {
+#ifdef __linux__
+    if (pin) {
+        // Worker i takes the CPU after the caller's, so the pool fills the allowed set in order
+        std::vector<int> cpus = allowedCpus();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[(worker + 1) % cpus.size()], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)worker;
+    (void)pin;
+#endif
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        Job* job = nullptr;
+        wake_.wait(lock, [&]() {
+            if (stop_) return true;
+            for (Job* candidate : jobs_) {
+                if (candidate->next < candidate->count && candidate->helpers < candidate->helperLimit) {
+                    job = candidate;
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (stop_) return;
+
+        ++job->helpers;
+        while (job->next < job->count) execute(*job, job->next++, lock);
+        --job->helpers;
+    }
+}
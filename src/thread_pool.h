@@ -0,0 +1,93 @@
+// thread_pool.h
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide pool of worker threads, started on first use and kept for the
+// life of the process so batch and sweep runs do not pay for thread creation
+// per file or per algorithm. The calling thread always works on its own job,
+// so nested calls (an algorithm inside a batch worker) cannot deadlock.
+class ThreadPool {
+public:
+    // Pins worker i to the i-th CPU the process may run on. Must be called
+    // before the first shared() to take effect.
+    static void setAffinity(bool pin);
+    static ThreadPool& shared();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    // Threads that can work at once: the workers plus the caller
+    size_t concurrency() const { return workers_.size() + 1; }
+
+    // CPU time each worker thread has used so far, in seconds; empty where
+    // per-thread clocks are unavailable. Workers block while idle, so this is
+    // their busy time.
+    std::vector<double> workerCpuSeconds();
+
+    // Number of chunks parallelFor uses for n items
+    static size_t chunkCount(size_t n, size_t grain, int maxThreads) {
+        if (n == 0) return 0;
+        size_t byGrain = std::max<size_t>(1, n / std::max<size_t>(grain, 1));
+        return std::min(byGrain, static_cast<size_t>(std::max(1, maxThreads)));
+    }
+
+    // Splits [begin, end) into chunkCount() contiguous chunks of near-equal
+    // size and calls fn(chunk, chunkBegin, chunkEnd) for each, on at most
+    // maxThreads threads. Chunks are never empty. Rethrows the first
+    // exception thrown by fn once every chunk has finished.
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, size_t grain, int maxThreads, Fn&& fn) {
+        size_t n = end > begin ? end - begin : 0;
+        size_t chunks = chunkCount(n, grain, maxThreads);
+        forEachIndex(chunks, maxThreads, [&](size_t c) {
+            fn(c, begin + n * c / chunks, begin + n * (c + 1) / chunks);
+        });
+    }
+
+    // Calls fn(i) for every i in [0, count), handing indices out one at a
+    // time to at most maxThreads threads.
+    template <typename Fn>
+    void forEachIndex(size_t count, int maxThreads, Fn&& fn) {
+        if (count <= 1 || maxThreads <= 1 || workers_.empty()) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+        Job job;
+        job.count = count;
+        job.helperLimit = std::min(count, static_cast<size_t>(maxThreads)) - 1;
+        job.run = [&fn](size_t i) { fn(i); };
+        run(job);
+    }
+
+private:
+    struct Job {
+        size_t count = 0;
+        size_t next = 0, done = 0;
+        size_t helpers = 0, helperLimit = 0;
+        std::function<void(size_t)> run;
+        std::exception_ptr error;
+    };
+
+    explicit ThreadPool(size_t workers, bool pin);
+    void run(Job& job);
+    void execute(Job& job, size_t index, std::unique_lock<std::mutex>& lock);
+    void workerLoop(size_t worker, bool pin);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    std::deque<Job*> jobs_;
+    bool stop_ = false;
+};
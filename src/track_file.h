@@ -0,0 +1,260 @@
+// track_file.h
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bit_labels.h"
+#include "mapped_file.h"
+
+// Binary columnar cache for prediction and label tracks (.pstrack).
+//
+//   TrackHeader                          32 bytes
+//   TrackColumn[columnCount]             64 bytes each
+//   column data, each 64-byte aligned
+//
+// Integers are little-endian as written by the host. Column encodings:
+//   TRACK_BITS       labels packed 64 per uint64_t word, as in BitLabels
+//   TRACK_DELTA_I32  int32 first value followed by successive differences
+//   TRACK_F32        float32 values
+//   TRACK_U16        uint16 q with value = q / 65535, for values in [0, 1]
+
+constexpr char TRACK_MAGIC[8] = {'P', 'S', 'P', 'T', 'R', 'A', 'C', 'K'};
+constexpr uint32_t TRACK_VERSION = 1;
+constexpr size_t TRACK_ALIGNMENT = 64;
+
+enum TrackColumnType : uint32_t {
+    TRACK_BITS = 1,
+    TRACK_DELTA_I32 = 2,
+    TRACK_F32 = 3,
+    TRACK_U16 = 4,
+};
+
+struct TrackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t rows;
+    uint64_t reserved;
+};
+
+struct TrackColumn {
+    char name[40];
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+static_assert(sizeof(TrackHeader) == 32, "TrackHeader layout");
+static_assert(sizeof(TrackColumn) == 64, "TrackColumn layout");
+
+// True if the file starts with the track magic
+inline bool isTrackFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(TRACK_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, TRACK_MAGIC, sizeof(magic)) == 0;
+}
+
+// Collects columns of equal length and writes them as one track file.
+class TrackWriter {
+public:
+    explicit TrackWriter(size_t rows) : rows_(rows) {}
+
+    void addBits(const std::string& name, const BitLabels& bits) {
+        checkRows(name, bits.size());
+        const auto& words = bits.words();
+        add(name, TRACK_BITS, words.data(), words.size() * sizeof(uint64_t));
+    }
+
+    void addIntegers(const std::string& name, const std::vector<long long>& values) {
+        checkRows(name, values.size());
+        std::vector<int32_t> deltas(values.size());
+        long long previous = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            long long delta = values[i] - previous;
+            if (delta < INT32_MIN || delta > INT32_MAX) {
+                throw std::runtime_error("Column '" + name + "' step does not fit in 32 bits");
+            }
+            deltas[i] = static_cast<int32_t>(delta);
+            previous = values[i];
+        }
+        add(name, TRACK_DELTA_I32, deltas.data(), deltas.size() * sizeof(int32_t));
+    }
+
+    // Stores float32, or uint16 steps of 1/65535 when quantize is set
+    void addFloats(const std::string& name, const std::vector<float>& values, bool quantize) {
+        checkRows(name, values.size());
+        if (!quantize) {
+            add(name, TRACK_F32, values.data(), values.size() * sizeof(float));
+            return;
+        }
+        std::vector<uint16_t> quantized(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            float clamped = std::min(1.0f, std::max(0.0f, values[i]));
+            quantized[i] = static_cast<uint16_t>(std::lround(clamped * 65535.0f));
+        }
+        add(name, TRACK_U16, quantized.data(), quantized.size() * sizeof(uint16_t));
+    }
+
+    void write(const std::string& filename) const {
+        TrackHeader header = {};
+        std::memcpy(header.magic, TRACK_MAGIC, sizeof(TRACK_MAGIC));
+        header.version = TRACK_VERSION;
+        header.columnCount = static_cast<uint32_t>(columns_.size());
+        header.rows = rows_;
+
+        std::vector<TrackColumn> directory = columns_;
+        uint64_t offset = align(sizeof(TrackHeader) + directory.size() * sizeof(TrackColumn));
+        for (auto& column : directory) {
+            column.offset = offset;
+            offset = align(offset + column.bytes);
+        }
+
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open output file: " + filename);
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(TrackColumn));
+        static const char padding[TRACK_ALIGNMENT] = {};
+        uint64_t position = sizeof(TrackHeader) + directory.size() * sizeof(TrackColumn);
+        for (size_t c = 0; c < directory.size(); ++c) {
+            file.write(padding, directory[c].offset - position);
+            file.write(data_[c].data(), data_[c].size());
+            position = directory[c].offset + directory[c].bytes;
+        }
+        file.write(padding, align(position) - position);
+        if (!file) {
+            throw std::runtime_error("Could not write output file: " + filename);
+        }
+    }
+
+private:
+    static uint64_t align(uint64_t offset) { return (offset + TRACK_ALIGNMENT - 1) & ~uint64_t(TRACK_ALIGNMENT - 1); }
+
+    void checkRows(const std::string& name, size_t rows) const {
+        if (rows != rows_) {
+            throw std::runtime_error("Column '" + name + "' has " + std::to_string(rows) + " rows, expected " + std::to_string(rows_));
+        }
+        if (name.size() >= sizeof(TrackColumn::name)) {
+            throw std::runtime_error("Column name too long: " + name);
+        }
+    }
+
+    void add(const std::string& name, TrackColumnType type, const void* bytes, size_t size) {
+        TrackColumn column = {};
+        std::memcpy(column.name, name.data(), name.size());
+        column.type = type;
+        column.bytes = size;
+        columns_.push_back(column);
+        data_.emplace_back(static_cast<const char*>(bytes), static_cast<const char*>(bytes) + size);
+    }
+
+    size_t rows_;
+    std::vector<TrackColumn> columns_;
+    std::vector<std::vector<char>> data_;
+};
+
+// Memory-mapped track file. Columns are read in place; only the header and
+// column directory are validated on open.
+class TrackFile {
+public:
+    explicit TrackFile(const std::string& filename) : filename_(filename), file_(filename) {
+        if (file_.size() < sizeof(TrackHeader) || std::memcmp(file_.data(), TRACK_MAGIC, sizeof(TRACK_MAGIC)) != 0) {
+            throw std::runtime_error("Not a track file: " + filename);
+        }
+        std::memcpy(&header_, file_.data(), sizeof(header_));
+        if (header_.version != TRACK_VERSION) {
+            throw std::runtime_error("Unsupported track file version in " + filename);
+        }
+        if (sizeof(TrackHeader) + uint64_t(header_.columnCount) * sizeof(TrackColumn) > file_.size()) {
+            throw std::runtime_error("Truncated track file: " + filename);
+        }
+        columns_ = reinterpret_cast<const TrackColumn*>(file_.data() + sizeof(TrackHeader));
+        for (uint32_t c = 0; c < header_.columnCount; ++c) {
+            if (columns_[c].offset + columns_[c].bytes > file_.size() || columns_[c].offset % TRACK_ALIGNMENT != 0) {
+                throw std::runtime_error("Corrupt column directory in " + filename);
+            }
+        }
+    }
+
+    size_t rows() const { return static_cast<size_t>(header_.rows); }
+
+    // Column with the given name, or nullptr
+    const TrackColumn* find(const std::string& name) const {
+        for (uint32_t c = 0; c < header_.columnCount; ++c) {
+            if (std::strncmp(columns_[c].name, name.c_str(), sizeof(columns_[c].name)) == 0) return &columns_[c];
+        }
+        return nullptr;
+    }
+
+    template <typename T>
+    const T* data(const TrackColumn& column) const {
+        return reinterpret_cast<const T*>(file_.data() + column.offset);
+    }
+
+    BitLabels bits(const std::string& name) const {
+        const TrackColumn& column = require(name, TRACK_BITS);
+        BitLabels bits(rows());
+        auto& words = bits.words();
+        std::memcpy(words.data(), data<uint64_t>(column), words.size() * sizeof(uint64_t));
+        // Keep the BitLabels invariant even if the file carries stray tail bits
+        if (rows() % 64) words.back() &= (uint64_t(1) << (rows() % 64)) - 1;
+        return bits;
+    }
+
+    std::vector<long long> integers(const std::string& name) const {
+        const int32_t* deltas = data<int32_t>(require(name, TRACK_DELTA_I32));
+        std::vector<long long> values(rows());
+        long long value = 0;
+        for (size_t i = 0; i < values.size(); ++i) values[i] = value += deltas[i];
+        return values;
+    }
+
+    std::vector<float> floats(const std::string& name) const {
+        const TrackColumn* column = find(name);
+        if (column && column->type == TRACK_U16) {
+            const uint16_t* quantized = data<uint16_t>(*column);
+            std::vector<float> values(rows());
+            for (size_t i = 0; i < values.size(); ++i) values[i] = quantized[i] * (1.0f / 65535.0f);
+            return values;
+        }
+        const float* values = data<float>(require(name, TRACK_F32));
+        return std::vector<float>(values, values + rows());
+    }
+
+private:
+    const TrackColumn& require(const std::string& name, TrackColumnType type) const {
+        const TrackColumn* column = find(name);
+        if (!column) {
+            throw std::runtime_error("Column '" + name + "' not found in " + filename_);
+        }
+        if (column->type != type || column->bytes < expectedBytes(type)) {
+            throw std::runtime_error("Column '" + name + "' in " + filename_ + " has an unexpected encoding");
+        }
+        return *column;
+    }
+
+    uint64_t expectedBytes(TrackColumnType type) const {
+        switch (type) {
+            case TRACK_BITS: return (header_.rows + 63) / 64 * sizeof(uint64_t);
+            case TRACK_DELTA_I32: return header_.rows * sizeof(int32_t);
+            case TRACK_F32: return header_.rows * sizeof(float);
+            case TRACK_U16: return header_.rows * sizeof(uint16_t);
+        }
+        return 0;
+    }
+
+    std::string filename_;
+    MappedFile file_;
+    TrackHeader header_;
+    const TrackColumn* columns_ = nullptr;
+};